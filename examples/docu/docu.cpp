@@ -43,11 +43,7 @@ namespace docu {
 
         void other_fun(int i ) {
             auto f = factorial(std::allocator_arg, &docu::g_global_mem, i);
-            schedule(f); //schedule the coroutine
-            while (!f.ready()) { //wait for the result
-                std::this_thread::sleep_for(std::chrono::microseconds(1)); 
-            };
-            std::cout << "Result " << f.get() << std::endl;
+            std::cout << "Result " << wait(f) << std::endl; //schedule the coroutine and run other jobs until it is done
         }
     }
 
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <chrono>
 #include <numeric>
+#include <ctime>
 
 #include "VGJS.h"
 #include "VGJSCoro.h"
@@ -145,6 +146,182 @@ namespace test {
 	}
 
 
+	Coro<> test_steal_half(int num, int micro) {
+		JobSystem js;
+		auto nthreads = js.get_thread_count().value;
+		std::vector<std::atomic<int64_t>> first_run(nthreads);	//time when each thread ran its first job
+
+		for (bool half : { false, true }) {
+			if (half) js.enable_steal_half(); else js.disable_steal_half();
+			for (auto& f : first_run) f = -1;
+			js.clear_statistics();
+
+			auto start = high_resolution_clock::now();
+			std::pmr::vector<std::function<void(void)>> perfv{};
+			perfv.reserve(num);
+			for (int i = 0; i < num; ++i) {
+				perfv.push_back([&]() {
+					int64_t expected = -1;
+					first_run[js.get_thread_index().value].compare_exchange_strong(expected, duration_cast<microseconds>(high_resolution_clock::now() - start).count());
+					func_perf(micro);
+				});
+			}
+			start = high_resolution_clock::now();
+			co_await perfv;		//one fan out into the queue of this thread
+			auto duration = duration_cast<microseconds>(high_resolution_clock::now() - start);
+
+			int64_t rampup = 0;
+			for (auto& f : first_run) rampup = std::max(rampup, f.load());
+			auto stat = js.get_statistics();
+			std::cout << "Steal half " << std::left << std::setw(5) << (half ? "on" : "off") << " Time " << std::setw(8) << duration.count() << " us Ramp-up "
+				<< std::setw(8) << rampup << " us Steal attempts " << std::setw(10) << stat.m_steal_attempts << " Steals " << std::setw(8) << stat.m_steals
+				<< " Stolen jobs " << stat.m_stolen_jobs << std::endl;
+		}
+		js.disable_steal_half();
+		co_return;
+	}
+
+
+	Coro<> test_idle_policy(int rounds) {
+		JobSystem js;
+		auto nthreads = js.get_thread_count().value;
+		if (nthreads < 2) co_return;
+		auto old_policy = js.get_idle_policy();
+
+		std::vector<std::pair<std::string, IdlePolicy>> policies{
+			{ "Park at once", IdlePolicy{ 0, 1, microseconds(1000), false } },
+			{ "Default", IdlePolicy{} },
+			{ "Spin long", IdlePolicy{ 1 << 14, 1 << 4, microseconds(1000), false } },
+			{ "Adaptive", IdlePolicy{ 1 << 12, 1 << 4, microseconds(1000), true } }
+		};
+
+		for (int gap : { 10, 100, 1000 }) {
+			for (auto& [name, policy] : policies) {
+				js.set_idle_policy(policy);
+				int64_t latency = 0;
+				high_resolution_clock::time_point sent;
+				auto cpu = std::clock();
+				auto start = high_resolution_clock::now();
+				for (int i = 0; i < rounds; ++i) {
+					func_perf(gap);		//the other threads run out of jobs in the meantime
+					thread_index_t target{ (js.get_thread_index().value + 1) % nthreads };
+					sent = high_resolution_clock::now();
+					co_await Function{ [&]() { latency += duration_cast<nanoseconds>(high_resolution_clock::now() - sent).count(); }, target };
+				}
+				double wall = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1.0e6;
+				double cores = (double)(std::clock() - cpu) / CLOCKS_PER_SEC / wall;
+				std::cout << "Gap " << std::left << std::setw(5) << gap << " us " << std::setw(13) << name << " Wake latency " << std::setw(8)
+					<< latency / rounds / 1000.0 << " us CPU " << cores << " cores" << std::endl;
+			}
+		}
+		js.set_idle_policy(old_policy);
+		co_return;
+	}
+
+
+	Coro<> test_affinity(int rounds, int kbytes) {
+		JobSystem js;
+		auto nthreads = js.get_thread_count().value;
+		auto old_affinity = js.get_affinity();
+		std::vector<std::vector<int>> data(nthreads, std::vector<int>(kbytes * 1024 / sizeof(int), 1));	//each thread works on its own data
+		std::atomic<int64_t> sum = 0;
+
+		std::pmr::vector<Function> perfv{};
+		for (int i = 0; i < nthreads; ++i) {
+			perfv.push_back(Function{ [&, i]() {
+				int64_t s = 0;
+				for (int k = 0; k < 10; ++k) for (auto& v : data[i]) s += v;
+				sum += s;
+			}, thread_index_t{i} });
+		}
+
+		std::vector<std::pair<std::string, AffinityPolicy>> policies{
+			{ "Unpinned", AffinityPolicy{} },
+			{ "Compact", AffinityPolicy{ AffinityPolicy::compact } },
+			{ "Scatter", AffinityPolicy{ AffinityPolicy::scatter } },
+			{ "Skip SMT", AffinityPolicy{ AffinityPolicy::skip_smt } }
+		};
+
+		for (auto& [name, policy] : policies) {
+			js.set_affinity(policy);
+			co_await perfv;		//warm up, all threads apply the policy
+			js.clear_statistics();
+			auto start = high_resolution_clock::now();
+			for (int r = 0; r < rounds; ++r) {
+				func_perf(100);	//the other threads run out of jobs and may be migrated by the OS
+				co_await perfv;
+			}
+			auto duration = duration_cast<microseconds>(high_resolution_clock::now() - start);
+			auto stat = js.get_statistics();
+			std::cout << std::left << std::setw(10) << name << " Time " << std::setw(8) << duration.count() << " us Steals " << std::setw(8) << stat.m_steals
+				<< " Remote steals " << stat.m_remote_steals << std::endl;
+		}
+		js.set_affinity(old_affinity);
+		co_return;
+	}
+
+
+	//the JobQueue layout before padding: lock, head, tail and size of neighbouring queues share cache lines
+	struct packed_queue {
+		std::atomic_flag	m_lock = ATOMIC_FLAG_INIT;
+		Job*				m_head = nullptr;
+		Job*				m_tail = nullptr;
+		int32_t				m_size = 0;
+
+		void push(Job* job) {
+			while (m_lock.test_and_set(std::memory_order::acquire));
+			job->m_next = nullptr;
+			if (m_tail == nullptr) m_head = job;
+			else m_tail->m_next = job;
+			m_tail = job;
+			++m_size;
+			m_lock.clear(std::memory_order::release);
+		}
+
+		Job* pop() {
+			while (m_lock.test_and_set(std::memory_order::acquire));
+			Job* job = m_head;
+			if (job != nullptr) {
+				m_head = (Job*)job->m_next.load();
+				if (m_head == nullptr) m_tail = nullptr;
+				--m_size;
+			}
+			m_lock.clear(std::memory_order::release);
+			return job;
+		}
+	};
+
+	template<typename Q>
+	double false_sharing_throughput(int nthreads, int ops) {
+		std::vector<Q> queues(nthreads);	//one queue per thread, stored contiguously
+		std::vector<std::thread> threads;
+		auto start = high_resolution_clock::now();
+		for (int t = 0; t < nthreads; ++t) {
+			threads.emplace_back([&, t]() {
+				Job job(n_pmr::new_delete_resource());
+				for (int i = 0; i < ops; ++i) {
+					queues[t].push(&job);
+					queues[t].pop();
+				}
+			});
+		}
+		for (auto& t : threads) t.join();
+		auto duration = duration_cast<microseconds>(high_resolution_clock::now() - start);
+		return (double)nthreads * ops / std::max(duration.count(), (decltype(duration.count()))1);
+	}
+
+	void test_false_sharing(int ops) {
+		auto precision = std::cout.precision();
+		for (int nthreads : { 8, 16, 32 }) {
+			double packed = false_sharing_throughput<packed_queue>(nthreads, ops);
+			double padded = false_sharing_throughput<JobQueue<Job>>(nthreads, ops);
+			std::cout << "Threads " << std::setw(3) << nthreads << " Packed " << std::setw(8) << std::setprecision(4) << packed
+				<< " ops/us Padded " << std::setw(8) << padded << " ops/us Speedup " << padded / packed << std::endl;
+		}
+		std::cout << std::setprecision(precision);
+	}
+
+
 	template<bool WITHALLOCATE = false, typename FT1 = Function, typename FT2 = std::function<void(void)>>
 	Coro<std::tuple<double,double>> performance_function(bool print = true, bool wrtfunc = true, int num = 1000, int micro = 1, std::pmr::memory_resource* mr = std::pmr::new_delete_resource()) {
 		JobSystem js;
@@ -238,6 +415,18 @@ namespace test {
 		std::cout << "\n\nTest utilization drop\n";
 		co_await test_utilization_drop(4);		
 
+		std::cout << "\n\nTest steal half\n";
+		co_await test_steal_half(100000, 1);
+
+		std::cout << "\n\nTest idle policy\n";
+		co_await test_idle_policy(200);
+
+		std::cout << "\n\nTest affinity\n";
+		co_await test_affinity(1000, 128);
+
+		std::cout << "\n\nTest false sharing\n";
+		test_false_sharing(1000000);
+
 		std::cout << "\n\nPerformance: min work (in microsconds) per job so that efficiency is >0.85 or >0.95\n";
 
 		co_await performance_driver<false,pfvoid, pfvoid>("void(*)() calls (w / o allocate)");
@@ -17,6 +17,9 @@ namespace test {
 
 	using namespace vgjs;
 
+	const thread_type_t render_type{ 1000 };	//jobs of this type run in the render worker group
+	std::thread::id		g_main_thread;			//the main thread enters the job system as thread 0
+
 	const int num_blocks = 50000;
 	const int block_size = 1 << 10;
 
@@ -35,11 +38,72 @@ namespace test {
 		if (i > 0) (*atomic_int)++;
 	}
 
+	int fib_scope(int n) {
+		if (n < 2) return n;
+		int a = 0, b = 0;
+		task_scope scope;
+		scope.spawn([&]() { a = fib_scope(n - 1); });
+		b = fib_scope(n - 2);
+		scope.wait();
+		return a + b;
+	}
+
+	void pinned_stream(std::atomic<int>* atomic_int, std::atomic<bool>* flag) {	//pinned jobs that keep the thread busy until the flag is set
+		if ((*atomic_int)++ == 0) schedule(Function{ [=]() { *flag = true; }, thread_index_t{}, render_type });
+		if (!flag->load() && atomic_int->load() < 10000) schedule(Function{ [=]() { pinned_stream(atomic_int, flag); }, JobSystem().get_thread_index() });
+	}
+
+	int scope_reuse() {	//one scope for several rounds of spawn and wait
+		std::atomic<int> sum = 0;
+		task_scope scope;
+		for (int i = 1; i <= 3; ++i) {
+			for (int j = 0; j < 10; ++j) scope.spawn([&]() { sum++; });
+			scope.wait();
+			if (sum.load() != 10 * i) return -1;
+		}
+		return sum.load();
+	}
+
+	int scope_destructor() {	//the destructor waits, children with high priority
+		std::atomic<int> sum = 0;
+		{
+			task_scope scope;
+			for (int j = 0; j < 10; ++j) scope.spawn([&]() { if (current_job()->m_priority.value == priority_high.value) sum++; }, priority_high);
+		}
+		return sum.load();
+	}
+
+	void elastic_load(std::atomic<int>* max_active) {	//many short children, remember the most active threads
+		for (int i = 0; i < 1000; ++i) schedule([=]() {
+			auto start = std::chrono::high_resolution_clock::now();
+			while (std::chrono::high_resolution_clock::now() - start < std::chrono::microseconds(20)) {}
+			int active = JobSystem().get_active_threads().value;
+			int old = max_active->load();
+			while (active > old && !max_active->compare_exchange_weak(old, active)) {}
+		});
+	}
+
 	void func2(std::atomic<int>* atomic_int, int i = 1) {
 		if (i > 1) continuation([=]() { func(atomic_int, i - 1); });
 		if (i > 0) (*atomic_int)++;
 	}
 
+	void func_prio(std::atomic<int>* atomic_int, priority_t prio, int i = 1) {
+		if (i > 1) schedule([=]() { func_prio(atomic_int, prio, i - 1); });	//child inherits the priority
+		if (i > 0 && current_job()->m_priority.value == prio.value) (*atomic_int)++;
+	}
+
+	void func_chain(std::atomic<int>* atomic_int, int i = 1) {
+		(*atomic_int)++;
+		if (i > 1) continuation([=]() { func_chain(atomic_int, i - 1); });	//runs next on this thread
+	}
+
+	Coro<> coro_prio(std::atomic<int>* atomic_int, priority_t prio, int i = 1) {
+		if (i > 1) co_await coro_prio(atomic_int, prio, i - 1);
+		if (i > 0 && current_job()->m_priority.value == prio.value) (*atomic_int)++;
+		co_return;
+	}
+
 	Coro<> coro_void(std::allocator_arg_t, n_pmr::memory_resource* mr, std::atomic<int>* atomic_int, int i = 1) {
 		if (i > 1) co_await coro_void(std::allocator_arg, mr, atomic_int, i - 1);
 		if (i > 0) (*atomic_int)++;
@@ -167,6 +231,90 @@ namespace test {
 		TESTRESULT(++number, "Vector Par Functions", co_await parallel(vf4_1, vf4_2), counter.load() == 40, counter = 0);
 		TESTRESULT(++number, "Vector Par Functions again", co_await parallel(vf4_1, vf4_2), counter.load() == 40, counter = 0);
 
+		js.enable_steal_half();
+		TESTRESULT(++number, "Steal half Functions", co_await vf4, counter.load() == 20, counter = 0);
+		TESTRESULT(++number, "Steal half Par Functions", co_await parallel(vf4_1, vf4_2), counter.load() == 40, counter = 0);
+		js.disable_steal_half();
+
+		//priorities
+		TESTRESULT(++number, "Inherited priority", co_await[&]() { func_prio(&counter, priority_normal, 10); }, counter.load() == 10, counter = 0);
+		auto fhigh = Function{ [&]() { func_prio(&counter, priority_high, 10); }, thread_index_t{}, thread_type_t{}, thread_id_t{}, priority_high };
+		auto flow = Function{ [&]() { func_prio(&counter, priority_low, 10); }, thread_index_t{}, thread_type_t{}, thread_id_t{}, priority_low };
+		TESTRESULT(++number, "High priority Function", co_await fhigh, counter.load() == 10, counter = 0);
+		TESTRESULT(++number, "Mixed priority Functions", co_await parallel(flow, fhigh), counter.load() == 20, counter = 0);
+		TESTRESULT(++number, "High priority Coro", co_await coro_prio(&counter, priority_high, 10)(thread_index_t{}, thread_type_t{}, thread_id_t{}, priority_high), counter.load() == 10, counter = 0);
+
+		//deadlines
+		js.enable_deadline_scheduling();
+		js.clear_statistics();
+		auto fdl = Function{ [&]() { func(&counter, 10); }, thread_index_t{}, thread_type_t{}, thread_id_t{}, priority_t{}, high_resolution_clock::now() + seconds(100) };
+		TESTRESULT(++number, "Deadline Function", co_await fdl, counter.load() == 10 && js.get_statistics().m_deadline_jobs == 10 && js.get_statistics().m_deadline_misses == 0, counter = 0);
+		js.clear_statistics();
+		auto fmiss = Function{ [&]() { func(&counter, 10); }, thread_index_t{}, thread_type_t{}, thread_id_t{}, priority_t{}, high_resolution_clock::now() };
+		TESTRESULT(++number, "Missed deadline Function", co_await parallel(fmiss, fdl), counter.load() == 20 && js.get_statistics().m_deadline_misses == 10, counter = 0);
+		js.clear_statistics();
+		TESTRESULT(++number, "Deadline Coro", co_await coro_void(std::allocator_arg, &g_global_mem, &counter, 10)(thread_index_t{}, thread_type_t{}, thread_id_t{}, priority_t{}, high_resolution_clock::now() + seconds(100)), counter.load() == 10 && js.get_statistics().m_deadline_jobs == 10, counter = 0);
+		js.disable_deadline_scheduling();
+
+		//worker groups
+		int render = js.get_thread_count().value - 1;	//the render group is the last thread
+		auto frender = Function{ [&]() { if (js.get_thread_index().value == render) counter++; }, thread_index_t{}, render_type };
+		TESTRESULT(++number, "Render group Function", co_await frender, counter.load() == 1, counter = 0);
+		std::pmr::vector<Function> vgroup;
+		for (int i = 0; i < 100; ++i) vgroup.emplace_back([&]() { if (js.get_thread_index().value != render) counter++; });
+		TESTRESULT(++number, "Default group Functions", co_await vgroup, counter.load() == 100, counter = 0);
+
+		//main thread
+		auto fmain = Function{ [&]() { if (std::this_thread::get_id() == g_main_thread) counter++; }, thread_index_t{ 0 } };
+		TESTRESULT(++number, "Function on main thread", co_await fmain, counter.load() == 1, counter = 0);
+
+		//wait
+		int waited = 0;
+		TESTRESULT(++number, "Wait for Functions", co_await[&]() { wait([&]() { func(&counter, 10); }); waited = counter.load(); }, waited == 10, counter = 0);
+		waited = 0;
+		std::atomic<bool> finished = false;
+		std::thread plain([&]() { if (wait([&]() { func(&counter, 10); })) waited = counter.load(); finished = true; });
+		auto fnop = Function{ []() {} };
+		while (!finished.load()) co_await fnop;	//keep this worker free for the children, it may be the only one
+		TESTRESULT(++number, "Wait in a plain thread", plain.join(), waited == 10, counter = 0);
+		TESTRESULT(++number, "Task scope fib(15)", co_await[&]() { waited = fib_scope(15); }, waited == 610, waited = 0);
+		TESTRESULT(++number, "Task scope reuse", co_await[&]() { waited = scope_reuse(); }, waited == 30, waited = 0);
+		TESTRESULT(++number, "Task scope destructor waits", co_await[&]() { waited = scope_destructor(); }, waited == 10, waited = 0);
+		TESTRESULT(++number, "Yield to pinned Function", co_await[&]() { schedule(Function{ [&]() { counter++; }, js.get_thread_index() }); for (int i = 0; i < 1000 && counter.load() == 0; ++i) yield(); }, counter.load() == 1, counter = 0);
+		TESTRESULT(++number, "Wait for Coro<int>", co_await[&]() { waited = wait(coro_int(std::allocator_arg, &g_global_mem, &counter)); }, waited == 1 && counter.load() == 1, counter = 0);
+
+		//fairness
+		std::atomic<bool> flag = false;
+		js.enable_wait_statistics();
+		js.clear_statistics();
+		auto fstream = Function{ [&]() { pinned_stream(&counter, &flag); }, thread_index_t{ render } };
+		TESTRESULT(++number, "Pinned stream vs group Function", co_await fstream, flag.load() && counter.load() <= 2 * (int)js.get_fair_burst() && js.get_statistics().m_local_jobs > 0, counter = 0);
+		js.disable_wait_statistics();
+
+		//elastic pool
+		std::pmr::vector<Function> velastic;
+		for (int i = 0; i < 100; ++i) velastic.emplace_back([&]() { if (js.get_thread_index().value == 0) counter++; });
+		js.set_active_threads(thread_count_t{ 1 });
+		TESTRESULT(++number, "One active thread Functions", co_await velastic, counter.load() == 100 && js.get_active_threads().value == 1, counter = 0);
+		js.set_active_threads(thread_count_t{ render });	//all threads of the default group
+		js.set_active_threads(thread_count_t{ 1 });
+		js.set_elastic_policy(ElasticPolicy{ .m_auto = true, .m_grow_depth = 4, .m_shrink_idle = std::chrono::microseconds(1000) });
+		TESTRESULT(++number, "Elastic pool grows under load", co_await(Function{ [&]() { elastic_load(&counter); }, thread_index_t{ 0 } }), counter.load() >= std::min(2, render), counter = 0);
+		for (int i = 0; i < 1000 && js.get_active_threads().value > 1; ++i) {	//only thread 0 runs jobs, so the others are idle
+			co_await(Function{ []() { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }, thread_index_t{ 0 } });
+		}
+		TESTRESULT(++number, "Elastic pool shrinks when idle", , js.get_active_threads().value == 1, );
+		js.set_elastic_policy(ElasticPolicy{});
+		js.set_active_threads(thread_count_t{ render });
+
+		//next slot
+		TESTRESULT(++number, "Continuation chain", co_await Function{ [&]() { func_chain(&counter, 10); } }, counter.load() == 10, counter = 0);
+		js.enable_inline_continuations(4);
+		js.clear_statistics();
+		TESTRESULT(++number, "Inline continuation chain", co_await Function{ [&]() { func_chain(&counter, 10); } }, counter.load() == 10 && js.get_statistics().m_inline_continuations == 8, counter = 0);
+		js.disable_inline_continuations();
+		TESTRESULT(++number, "Parallel continuation chains", co_await parallel(Function{ [&]() { func_chain(&counter, 10); } }, Function{ [&]() { func_chain(&counter, 10); } }), counter.load() == 20, counter = 0);
+
 		//Coro
 		TESTRESULT(++number, "Single Coro<>", co_await coro_void(std::allocator_arg, &g_global_mem, &counter), counter.load() == 1, counter = 0);
 		TESTRESULT(++number, "10 Coro<>", co_await coro_void(std::allocator_arg, &g_global_mem, &counter, 10), counter.load() == 10, counter = 0);
@@ -190,6 +338,7 @@ namespace test {
 
 		TESTRESULT(++number, "Single Coro<int>", auto ret1 = co_await coro_int(std::allocator_arg, &g_global_mem, &counter), ret1 == 1 && counter.load() == 1, counter = 0);
 		TESTRESULT(++number, "10 Coro<int>", auto ret2 = co_await coro_int(std::allocator_arg, &g_global_mem, &counter, 10), ret2 == 10 && counter.load() == 10, counter = 0);
+		TESTRESULT(++number, "10000 Coro<int>", auto ret2b = co_await coro_int(std::allocator_arg, &g_global_mem, &counter, 10000), ret2b == 10000 && counter.load() == 10000, counter = 0);
 		auto [ret3, ret4] = co_await parallel(coro_int(std::allocator_arg, &g_global_mem, &counter), coro_int(std::allocator_arg, &g_global_mem, &counter));
 		TESTRESULT(++number, "Parallel Coro<int>", , ret3 == 1 && ret4 == 1 && counter.load() == 2, counter = 0);
 		auto [ret5, ret6] = co_await parallel(coro_int(std::allocator_arg, &g_global_mem, &counter, 10), coro_int(std::allocator_arg, &g_global_mem, &counter, 10));
@@ -296,6 +445,22 @@ namespace test {
 		TESTRESULT(++number, "Tagged jobs 1", co_await tag_t{ 1 }, counter.load() == 2, );
 		TESTRESULT(++number, "Tagged jobs 2", co_await tag_t{ 2 }, counter.load() == 4, );
 		TESTRESULT(++number, "Tagged jobs 3", co_await tag_t{ 3 }, counter.load() == 10, counter = 0);
+
+		js.register_tag(tag_t{ 1000 });
+		std::pmr::vector<Function> vtag;
+		for (int i = 0; i < 100; ++i) vtag.emplace_back([&]() { for (int j = 0; j < 10; ++j) schedule([&]() { counter++; }, tag_t{ 1000 }); });
+		co_await vtag;	//fill the tag from many workers at once
+		TESTRESULT(++number, "Tagged jobs from many threads", co_await tag_t{ 1000 }, counter.load() == 1000, counter = 0);
+		std::pmr::vector<Function> vlarge;
+		for (int i = 0; i < 300; ++i) vlarge.emplace_back([&]() { for (int j = 0; j < 10; ++j) schedule([&]() { counter++; }, tag_t{ 1000 }); });
+		co_await vlarge;	//3000 jobs are released in chunks by several threads
+		js.clear_statistics();
+		TESTRESULT(++number, "Large tag in chunks", co_await tag_t{ 1000 }, counter.load() == 3000 && js.get_statistics().m_tag_chunks >= (3000 + 255) / 256, counter = 0);
+		std::atomic<int> leaves = 0;
+		for (int i = 0; i < 1000; ++i) schedule([&]() { counter++; schedule([&]() { leaves++; }, tag_t{ 1001 }); }, tag_t{ 1001 });
+		TESTRESULT(++number, "Push into a released tag", co_await tag_t{ 1001 }, counter.load() == 1000 && leaves.load() == 0, );	//new jobs wait for the next release
+		for (int i = 0; i < 10 && counter.load() + leaves.load() < 2000; ++i) co_await tag_t{ 1001 };
+		TESTRESULT(++number, "Pushed jobs in later releases", , counter.load() == 1000 && leaves.load() == 1000, counter = 0);
 		
 		vgjs::terminate();
 
@@ -310,11 +475,12 @@ using namespace vgjs;
 int main(int argc, char* argv[])
 {
 	int num = argc > 1 ? std::stoi(argv[1]) : 0;
-	JobSystem js(thread_count_t{ num });
+	JobSystem js({ WorkerGroup{ thread_type_t{}, thread_count_t{ num } }, WorkerGroup{ test::render_type, thread_count_t{ 1 }, "render" } }, thread_index_t{ 1 });
 
+	test::g_main_thread = std::this_thread::get_id();
 	schedule(test::start_test());
 
-	wait_for_termination();
+	js.enter();		//the main thread runs jobs as thread 0 until vgjs::terminate() is called
 	std::cerr << "Press Any Key + Return to Exit\n";
 	std::string str;
 	std::cin >> str;
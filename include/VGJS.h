@@ -35,6 +35,8 @@
 #include <sstream>
 #include <compare>
 #include <unordered_map>
+#include <shared_mutex>
+#include <array>
 
 #include "IntType.h"
 
@@ -42,6 +44,7 @@ using namespace std::chrono;
 
 
 #if(defined(_MSC_VER))
+    #include <intrin.h>
     #include <memory_resource>
     namespace n_exp = std::experimental;
     namespace n_pmr = std::pmr;
@@ -59,6 +62,29 @@ using namespace std::chrono;
 #else
 #endif
 
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+        #define VGJS_UNDEF_NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+        #define VGJS_UNDEF_WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+    #ifdef VGJS_UNDEF_NOMINMAX          //do not change how the including code sees windows.h
+        #undef NOMINMAX
+        #undef VGJS_UNDEF_NOMINMAX
+    #endif
+    #ifdef VGJS_UNDEF_WIN32_LEAN_AND_MEAN
+        #undef WIN32_LEAN_AND_MEAN
+        #undef VGJS_UNDEF_WIN32_LEAN_AND_MEAN
+    #endif
+#elif defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
 
 namespace vgjs {
 
@@ -72,6 +98,14 @@ namespace vgjs {
     using thread_count_t = int_type<int, struct P3, -1>;
     using tag_t = int_type<int, struct P4, -1>;
     using parent_t = int_type<int, struct P5, -1>;
+    using priority_t = int_type<int, struct P6, -1>;
+
+    inline const priority_t priority_high{ 0 };     ///<jobs are run before all other jobs
+    inline const priority_t priority_normal{ 1 };   ///<default priority of jobs without a parent
+    inline const priority_t priority_low{ 2 };      ///<background jobs, run only if there is nothing else to do
+
+    using deadline_t = std::chrono::high_resolution_clock::time_point;
+    inline const deadline_t no_deadline = deadline_t::max();   ///<jobs without a deadline
 
     bool is_logging();
     void log_data(  std::chrono::high_resolution_clock::time_point& t1
@@ -90,26 +124,196 @@ namespace vgjs {
 
     //---------------------------------------------------------------------------------------------------
 
+    /**
+    * \brief Size of a cache line. Data written by different threads is kept this far apart to avoid false sharing.
+    */
+    inline constexpr std::size_t cache_line_size = 64;
+
+    /**
+    * \brief Tell the CPU that this is a spin loop, so it can save power and free resources for a sibling hyperthread.
+    */
+    inline void cpu_pause() noexcept {
+    #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_pause();
+    #elif defined(_MSC_VER) && (defined(_M_ARM64) || defined(_M_ARM))
+        __yield();
+    #elif defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+    #elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield");
+    #else
+        std::this_thread::yield();
+    #endif
+    }
+
+    //---------------------------------------------------------------------------------------------------
+
+#if defined(__linux__)
+    /**
+    * \brief Get the logical CPUs the process may run on. The first call saves the affinity mask of the calling thread,
+    * so the job system calls it when it starts, before it pins any thread.
+    * \returns the saved affinity mask.
+    */
+    inline const cpu_set_t& process_cpus() noexcept {
+        static const cpu_set_t set = []() {
+            cpu_set_t res;
+            CPU_ZERO(&res);
+            if (sched_getaffinity(0, sizeof(res), &res) != 0) {     //unknown, so allow all CPUs
+                int num = (int)std::max(std::thread::hardware_concurrency(), 1u);
+                for (int i = 0; i < num && i < CPU_SETSIZE; ++i) CPU_SET(i, &res);
+            }
+            return res;
+        }();
+        return set;
+    }
+#endif
+
+    /**
+    * \brief Pin the calling thread to a logical CPU.
+    * \param[in] cpu The logical CPU, if negative then the thread may run on all CPUs of the process.
+    * \returns true if the affinity could be set.
+    */
+    inline bool set_thread_affinity(int cpu) noexcept {
+    #if defined(_WIN32)
+        DWORD_PTR process_mask, system_mask;
+        if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) return false;
+        if (cpu >= (int)sizeof(DWORD_PTR) * 8) return false;
+        DWORD_PTR mask = cpu < 0 ? process_mask : ((DWORD_PTR)1 << cpu);
+        return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+    #elif defined(__linux__)
+        if (cpu >= CPU_SETSIZE) return false;
+        cpu_set_t set = process_cpus();     //the mask the process started with, e.g. from taskset or a container
+        if (cpu >= 0) {
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+        }
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    #else
+        return false;   //no hard affinity, e.g. on macOS
+    #endif
+    }
+
+    /**
+    * \brief Physical location of a logical CPU.
+    */
+    struct cpu_info {
+        int m_cpu;          //number of the logical CPU
+        int m_core;         //physical core the CPU belongs to
+        int m_package;      //socket the core belongs to
+        int m_sibling;      //0 for the first logical CPU of a core, 1 for its SMT sibling, ...
+        int m_l3;           //last level cache the core belongs to
+        int m_node;         //NUMA node the core belongs to
+
+        enum distance_t { c_smt, c_l3, c_node, c_remote };  //distance levels between two logical CPUs
+
+        /**
+        * \brief Compute how far away another logical CPU is.
+        * \param[in] other The other logical CPU.
+        * \returns c_smt for a sibling of the same core, c_l3 if they share the last level cache,
+        * c_node if they are on the same NUMA node, else c_remote.
+        */
+        distance_t distance(const cpu_info& other) const noexcept {
+            if (m_package == other.m_package && m_core == other.m_core) return c_smt;
+            if (m_package == other.m_package && m_l3 == other.m_l3) return c_l3;
+            if (m_node == other.m_node) return c_node;
+            return c_remote;
+        }
+    };
+
+    /**
+    * \brief Get the topology of the logical CPUs. If it cannot be found out, then each logical CPU is its own core.
+    * \returns a vector with one entry per logical CPU.
+    */
+    inline std::vector<cpu_info> cpu_topology() {
+        int num = (int)std::max(std::thread::hardware_concurrency(), 1u);
+        std::vector<cpu_info> res;
+        for (int i = 0; i < num; ++i) res.push_back({ i, i, 0, 0, -1, -1 });
+
+    #if defined(_WIN32)
+        DWORD len = 0;
+        GetLogicalProcessorInformation(nullptr, &len);
+        std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> infos(len / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+        if (!infos.empty() && GetLogicalProcessorInformation(infos.data(), &len)) {
+            int core = 0, package = 0, l3 = 0;
+            for (auto& info : infos) {
+                bool is_l3 = info.Relationship == RelationCache && info.Cache.Level == 3;
+                if (info.Relationship != RelationProcessorCore && info.Relationship != RelationProcessorPackage
+                    && info.Relationship != RelationNumaNode && !is_l3) continue;
+                for (int i = 0; i < num && i < (int)sizeof(ULONG_PTR) * 8; ++i) {
+                    if ((info.ProcessorMask & ((ULONG_PTR)1 << i)) == 0) continue;
+                    if (info.Relationship == RelationProcessorCore) res[i].m_core = core;
+                    else if (info.Relationship == RelationProcessorPackage) res[i].m_package = package;
+                    else if (info.Relationship == RelationNumaNode) res[i].m_node = (int)info.NumaNode.NodeNumber;
+                    else res[i].m_l3 = l3;
+                }
+                if (info.Relationship == RelationProcessorCore) ++core;
+                else if (info.Relationship == RelationProcessorPackage) ++package;
+                else if (is_l3) ++l3;
+            }
+        }
+    #elif defined(__linux__)
+        for (auto& c : res) {
+            std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(c.m_cpu) + "/topology/";
+            std::ifstream core(dir + "core_id");
+            std::ifstream package(dir + "physical_package_id");
+            std::ifstream l3("/sys/devices/system/cpu/cpu" + std::to_string(c.m_cpu) + "/cache/index3/id");
+            if (core) core >> c.m_core;
+            if (package) package >> c.m_package;
+            if (l3) l3 >> c.m_l3;
+        }
+        int nodes = 0;
+        std::ifstream possible("/sys/devices/system/node/possible");    //like 0-3
+        if (possible >> nodes && possible.peek() == '-') possible.ignore() >> nodes;
+        for (int n = 0; n <= nodes; ++n) {          //each node lists its CPUs like 0-7,16-23
+            std::ifstream list("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+            if (!list) continue;
+            int first, last;
+            while (list >> first) {
+                last = first;
+                if (list.peek() == '-') list.ignore() >> last;
+                for (int i = first; i <= last && i < num; ++i) res[i].m_node = n;
+                if (list.peek() == ',') list.ignore();
+            }
+        }
+    #endif
+
+        for (auto& c : res) {       //if unknown then the socket is the cache domain and the node
+            if (c.m_l3 < 0) c.m_l3 = c.m_package;
+            if (c.m_node < 0) c.m_node = c.m_package;
+        }
+
+        for (auto& c : res) {       //number the SMT siblings of each core
+            c.m_sibling = (int)std::count_if(res.begin(), res.begin() + c.m_cpu
+                , [&](auto& o) { return o.m_core == c.m_core && o.m_package == c.m_package; });
+        }
+        return res;
+    }
+
+    //---------------------------------------------------------------------------------------------------
+
     /**
     * \brief Function struct wraps a c++ function of type std::function<void(void)>.
     *
     * It can hold a function, and additionally a thread index where the function should
     * be executed, a type and an id for dumping a trace file to be shown by
-    * Google Chrome about::tracing.
+    * Google Chrome about::tracing, a priority and a deadline. If no priority or deadline is given,
+    * then the job gets the priority and deadline of its parent.
     */
     struct Function {
         std::function<void(void)>   m_function = []() {};  //empty function
         thread_index_t              m_thread_index;        //thread that the f should run on
         thread_type_t               m_type;                //type of the call
         thread_id_t                 m_id;                  //unique identifier of the call
+        priority_t                  m_priority;            //priority of the call
+        deadline_t                  m_deadline;            //the call should be finished by then
 
         Function(std::function<void(void)>& f, thread_index_t index = thread_index_t{},
-            thread_type_t type = thread_type_t{}, thread_id_t id = thread_id_t{})
-            : m_function(f), m_thread_index(index), m_type(type), m_id(id) {};
+            thread_type_t type = thread_type_t{}, thread_id_t id = thread_id_t{}, priority_t prio = priority_t{}, deadline_t deadline = no_deadline)
+            : m_function(f), m_thread_index(index), m_type(type), m_id(id), m_priority(prio), m_deadline(deadline) {};
 
         Function(std::function<void(void)>&& f, thread_index_t index = thread_index_t{},
-            thread_type_t type = thread_type_t{}, thread_id_t id = thread_id_t{})
-            : m_function(std::move(f)), m_thread_index(index), m_type(type), m_id(id) {};
+            thread_type_t type = thread_type_t{}, thread_id_t id = thread_id_t{}, priority_t prio = priority_t{}, deadline_t deadline = no_deadline)
+            : m_function(std::move(f)), m_thread_index(index), m_type(type), m_id(id), m_priority(prio), m_deadline(deadline) {};
 
         Function(const Function& f) = default;
         Function(Function&& f) = default;
@@ -145,7 +349,7 @@ namespace vgjs {
     */
     class Queuable {
     public:
-        Queuable* m_next = nullptr;           //next job in the queue
+        std::atomic<Queuable*> m_next = nullptr;  //next job in the queue, atomic for the lock-free queues
     };
 
     /**
@@ -153,33 +357,39 @@ namespace vgjs {
     */
     class Job_base : public Queuable {
     public:
-        std::atomic<int>    m_children;         //number of children this job is waiting for
-        Job_base*           m_parent;           //parent job that created this job
+        std::atomic<int>    m_children;         //number of children this job is waiting for, hot like m_next, so keep them together
+        Job_base*           m_parent;           //parent job that created this job, this and the following fields are read mostly
         thread_index_t      m_thread_index;     //thread that the job should run on and ran on
         thread_type_t       m_type;             //for logging performance
         thread_id_t         m_id;               //for logging performance
+        priority_t          m_priority;         //priority class, empty means inherit from the parent
+        deadline_t          m_deadline;         //job should be finished by then, no_deadline means inherit from the parent
+        std::chrono::high_resolution_clock::time_point m_queued;    //when the job was queued, set only if wait statistics are enabled
         bool                m_is_function;      //default - this is not a function
 
-        Job_base() : m_children{ 0 }, m_parent{ nullptr }, m_thread_index{}, m_type{}, m_id{}, m_is_function{ false } {}
+        Job_base() : m_children{ 0 }, m_parent{ nullptr }, m_thread_index{}, m_type{}, m_id{}, m_priority{}, m_deadline{ no_deadline }, m_queued{}, m_is_function{ false } {}
 
         virtual bool resume() = 0;                      //this is the actual work to be done
         void operator() () noexcept {           //wrapper as function operator
             resume();
         }
         bool is_function() noexcept { return m_is_function; }         //test whether this is a function or e.g. a coro
-        virtual job_deallocator get_deallocator() noexcept { return job_deallocator{}; };    //called for deallocation
+        virtual job_deallocator& get_deallocator() noexcept { static job_deallocator da; return da; };    //called for deallocation
     };
 
 
     /**
     * \brief Job class calls normal C++ functions, is allocated and deallocated, and can be reused.
+    *
+    * Jobs are aligned to cache lines, so children finishing different Jobs do not falsely share a line.
     */
-    class Job : public Job_base {
+    class alignas(cache_line_size) Job : public Job_base {
     public:
         n_pmr::memory_resource*     m_mr = nullptr;  //memory resource that was used to allocate this Job
         Job_base*                   m_continuation = nullptr;   //continuation follows this job (a coro is its own continuation)
         std::function<void(void)>   m_function;      //function to compute
         pfvoid                      m_pfvoid=nullptr;
+        int                         m_node = -1;     //NUMA node whose pool this Job was allocated from, -1 if not from a node pool
 
         Job( n_pmr::memory_resource* pmr) : Job_base(), m_mr(pmr), m_continuation(nullptr) {
             m_children = 1;
@@ -187,13 +397,15 @@ namespace vgjs {
         }
 
         void reset() noexcept {         //call only if you want to wipe out the Job data
-            m_next = nullptr;           //e.g. when recycling from a used Jobs queue
+            m_next.store(nullptr, std::memory_order::relaxed); //e.g. when recycling from a used Jobs queue
             m_children = 1;
             m_parent = nullptr;
             m_continuation = nullptr;
             m_thread_index = thread_index_t{};
             m_type = thread_type_t{};
             m_id = thread_id_t{};
+            m_priority = priority_t{};
+            m_deadline = no_deadline;
         }
 
         bool resume() noexcept {    //work is to call the function
@@ -207,6 +419,36 @@ namespace vgjs {
     };
 
 
+    /**
+    * \brief Deallocator of jobs that are not allocated by the job system, it does nothing.
+    */
+    struct no_deallocator : public job_deallocator {
+        void deallocate(Job_base* job) noexcept {}
+    };
+
+
+    /**
+    * \brief A thread waits until all children of this job have finished, see vgjs::wait().
+    *
+    * Like a coro the job is scheduled when its last child has finished. Running it only signals
+    * the completion, so the waiting thread can go on. It lives on the stack of the waiting thread.
+    */
+    class WaitJob : public Job_base {
+    public:
+        std::mutex              m_mutex;        //protects m_done for threads sleeping on m_cv
+        std::condition_variable m_cv;
+        std::atomic<bool>       m_done = false; //true if all children have finished
+        thread_index_t          m_waiting;      //a worker that waits and must be woken up, or empty
+
+        WaitJob() : Job_base() {
+            m_children = 1;             //the waiting thread is also a child, until it has scheduled all children
+        }
+
+        bool resume() noexcept;         //signal the completion
+        job_deallocator& get_deallocator() noexcept { static no_deallocator da; return da; };   //lives on the stack, so never deallocate
+    };
+
+
     /**
     * \brief Deallocate a Job instance.
     * \param[in] job Pointer to the job.
@@ -240,11 +482,12 @@ namespace vgjs {
     * \brief General FIFO queue class.
     *
     * The queue allows for multiple producers multiple consumers. It uses a lightweight
-    * atomic flag as lock.
+    * atomic flag as lock. The lock and the fields it protects are always used together, so they share a
+    * cache line, but each queue has its own line.
     */
     template<typename JOB = Queuable, bool SYNC = true>
     requires std::is_base_of_v<Queuable, JOB >
-    class JobQueue {
+    class alignas(cache_line_size) JobQueue {
         friend JobSystem;
         std::atomic_flag m_lock = ATOMIC_FLAG_INIT;  //for locking the queue
         JOB*             m_head = nullptr;	        //points to first entry
@@ -266,7 +509,7 @@ namespace vgjs {
             uint32_t res = m_size;
             JOB* job = pop();                   //deallocate jobs that run a function
             while (job != nullptr) {            //because they were allocated by the JobSystem
-                auto da = job->get_deallocator(); //get deallocator
+                auto& da = job->get_deallocator(); //get deallocator
                 da.deallocate(job);             //deallocate the memory
                 job = pop();                    //get next entry
             }
@@ -293,12 +536,14 @@ namespace vgjs {
         /**
         * \brief Pushes a job onto the queue tail.
         * \param[in] job The job to be pushed into the queue.
+        * \returns true if the queue was empty before.
         */
-        void push(JOB* job) {
+        bool push(JOB* job) {
             if constexpr (SYNC) {
                 while (m_lock.test_and_set(std::memory_order::acquire));  // acquire lock
             }
-            job->m_next = nullptr;      //clear pointer to successor
+            bool was_empty = (m_tail == nullptr);
+            job->m_next.store(nullptr, std::memory_order::relaxed); //clear pointer to successor
             if (m_head == nullptr) {    //if queue is empty
                 m_head = job;           //let m_head point to the job
             }
@@ -306,7 +551,7 @@ namespace vgjs {
                 m_tail = job;           //let m_tail point to the job
             }
             else {
-                m_tail->m_next = (JOB*)job;   //add the job to the queue tail
+                m_tail->m_next.store(job, std::memory_order::relaxed);   //add the job to the queue tail
                 m_tail = job;           //m_tail points to the new job
             }
 
@@ -314,6 +559,34 @@ namespace vgjs {
             if constexpr (SYNC) {
                 m_lock.clear(std::memory_order::release); //release lock
             }
+            return was_empty;
+        };
+
+        /**
+        * \brief Splices a chain of jobs linked through m_next onto the queue tail.
+        * \param[in] first First job of the chain.
+        * \param[in] last Last job of the chain.
+        * \param[in] num Number of jobs in the chain.
+        * \returns true if the queue was empty before.
+        */
+        bool push(JOB* first, JOB* last, uint32_t num) {
+            if constexpr (SYNC) {
+                while (m_lock.test_and_set(std::memory_order::acquire));  // acquire lock
+            }
+            bool was_empty = (m_tail == nullptr);
+            last->m_next.store(nullptr, std::memory_order::relaxed);
+            if (was_empty) {            //if queue was empty
+                m_head = first;
+            }
+            else {
+                m_tail->m_next.store(first, std::memory_order::relaxed);
+            }
+            m_tail = last;
+            m_size += num;
+            if constexpr (SYNC) {
+                m_lock.clear(std::memory_order::release); //release lock
+            }
+            return was_empty;
         };
 
         /**
@@ -329,7 +602,7 @@ namespace vgjs {
 
             JOB* head = m_head;
             if (head != nullptr) {              //if there is a job at the head of the queue
-                m_head = (JOB*)head->m_next;    //let point m_head to its successor
+                m_head = (JOB*)head->m_next.load(std::memory_order::relaxed);    //let point m_head to its successor
                 m_size--;                       //decrease number of jobs
                 if (head == m_tail) {           //if this is the only job
                     m_tail = nullptr;           //let m_tail point to nullptr
@@ -341,257 +614,1801 @@ namespace vgjs {
             return head;
         };
 
+        /**
+        * \brief Pops up to num jobs from the head of the queue in one operation.
+        * \param[in] num Maximum number of jobs to pop.
+        * \param[out] first First popped job, the jobs remain linked through m_next.
+        * \param[out] last Last popped job.
+        * \param[in] half If true, pop at most half of the jobs in the queue (but at least one).
+        * \returns the number of popped jobs.
+        */
+        uint32_t pop(uint32_t num, JOB*& first, JOB*& last, bool half = false) {
+            first = last = nullptr;
+            if (m_head == nullptr || num == 0) return 0;
+
+            if constexpr (SYNC) {
+                while (m_lock.test_and_set(std::memory_order::acquire));  // acquire lock
+            }
+
+            if (half) num = std::min(num, (uint32_t)std::max(m_size / 2, 1));
+            uint32_t res = 0;
+            first = m_head;
+            while (m_head != nullptr && res < num) {
+                last = m_head;
+                m_head = (JOB*)m_head->m_next.load(std::memory_order::relaxed);
+                ++res;
+            }
+            m_size -= res;
+            if (m_head == nullptr) {
+                m_tail = nullptr;
+            }
+            if (last == nullptr) first = nullptr;
+            if constexpr (SYNC) {
+                m_lock.clear(std::memory_order::release);   //release lock
+            }
+            return res;
+        };
+
     };
 
 
     /**
-    * \brief The main JobSystem class manages the whole VGJS job system.
+    * \brief Lock-free intrusive FIFO queue for multiple producers and a single consumer.
     *
-    * The JobSystem starts N threads and provides them with data structures.
-    * It can add new jobs, and wait until they are done.
+    * This is Dmitry Vyukov's intrusive MPSC queue, the jobs are linked through
+    * Queuable::m_next. Producers never block each other or the consumer, a push
+    * is a single atomic exchange. Only the owning thread may call pop(). Head and tail are
+    * on different cache lines, so producers do not slow down the consumer.
     */
-    class JobSystem {
-        static inline const uint32_t c_queue_capacity = 1<<10; ///<save at most N Jobs for recycling
-        static inline const bool c_enable_logging = false;
-
-    private:
-        static inline std::atomic<uint64_t>             m_init_counter = 0;
-        static inline n_pmr::memory_resource*           m_mr;                   ///<use to allocate/deallocate Jobs
-        static inline std::vector<std::thread>	        m_threads;	            ///<array of thread structures
-        static inline std::atomic<uint32_t>   		    m_thread_count = 0;     ///<number of threads in the pool
-        static inline std::atomic<bool>                 m_terminated = false;   ///<flag set true when the last thread has exited
-        static inline thread_index_t				    m_start_idx;            ///<idx of first thread that is created
-        static inline thread_local thread_index_t	    m_thread_index = thread_index_t{};  ///<each thread has its own number
-        static inline std::atomic<bool>				    m_terminate = false;	///<Flag for terminating the pool
-        static inline thread_local Job_base*            m_current_job = nullptr;///<Pointer to the current job of this thread0
-        static inline std::vector<JobQueue<Job_base>>   m_global_queues;	    ///<each thread has its shared Job queue, multiple produce, multiple consume
-        static inline std::vector<JobQueue<Job_base>>   m_local_queues;	        ///<each thread has its own Job queue, multiple produce, single consume
-        static inline std::vector<std::unique_ptr<std::condition_variable>>                     m_cv;
-        static inline std::vector<std::unique_ptr<std::mutex>>                                  m_mutex;
-        static inline std::unordered_map<tag_t,std::unique_ptr<JobQueue<Job_base>>,tag_t::hash> m_tag_queues;
-        static inline thread_local JobQueue<Job,false>      m_recycle;        ///<save old jobs for recycling
-        static inline thread_local JobQueue<Job,false>      m_delete;         ///<save old jobs for deleting
-        static inline n_pmr::vector<n_pmr::vector<JobLog>>	m_logs;				    ///< log the start and stop times of jobs
-        static inline bool                                  m_logging = false;      ///< if true then jobs will be logged
-        static inline std::map<int32_t, std::string>        m_types;                ///<map types to a string for logging
-        static inline std::chrono::time_point<std::chrono::high_resolution_clock> m_start_time = std::chrono::high_resolution_clock::now();	//time when program started
+    template<typename JOB = Queuable>
+    requires std::is_base_of_v<Queuable, JOB >
+    class alignas(cache_line_size) LocalQueue {
+        alignas(cache_line_size) std::atomic<Queuable*> m_head;     //producers push here
+        alignas(cache_line_size) Queuable*              m_tail;     //consumer pops here, on its own cache line
+        Queuable                                        m_stub;     //dummy node, the queue is never physically empty
 
         /**
-        * \brief Allocate a job so that it can be scheduled.
-        *
-        * If there is a job in the recycle queue we use this. Else a new
-        * new Job struct is allocated from the memory resource m_mr.
-        *
-        * \returns a pointer to the job.
+        * \brief Link a job or the stub node to the queue head.
+        * \param[in] node The node to push.
         */
-        Job* allocate_job() {
-            Job* job = m_recycle.pop();                                 //try recycle queue
-            if (job == nullptr ) {                                      //none found
-                n_pmr::polymorphic_allocator<Job> allocator(m_mr);      //use this allocator
-                job = allocator.allocate(1);                            //allocate the object
-                if (job == nullptr) {
-                    std::cout << "No job available\n";
-                    std::terminate();
-                }
-                new (job) Job(m_mr);                 //call constructor
-            }
-            else {                                  //job found
-                job->reset();                       //reset it
-            }
-            return job;
+        void push_node(Queuable* node) noexcept {
+            node->m_next.store(nullptr, std::memory_order::relaxed);
+            Queuable* prev = m_head.exchange(node, std::memory_order::acq_rel);   //serialize producers
+            prev->m_next.store(node, std::memory_order::release);                //link the predecessor
         }
 
+    public:
+
+        LocalQueue() noexcept : m_head(&m_stub), m_tail(&m_stub) {};	///<LocalQueue class constructor
+
+        LocalQueue(const LocalQueue<JOB>& queue) noexcept : LocalQueue() {};
+
+        ~LocalQueue() {}  //destructor
+
         /**
-        * \brief Allocate a job so that it can be scheduled.
-        * \param[in] f Function that should be executed by the job.
-        * \returns a pointer to the Job.
+        * \brief Deallocate all Jobs in the queue. Must be called by the consumer.
         */
-        template <typename F>
-        requires FUNCTOR<F>
-        Job* allocate_job(F&& f) noexcept {
-            Job* job = allocate_job();
-            if constexpr (std::is_same_v<std::decay_t<F>, Function>) {
-                job->m_function     = f.get_function();
-                job->m_pfvoid       = nullptr;
-                job->m_thread_index = f.m_thread_index;
-                job->m_type         = f.m_type;
-                job->m_id           = f.m_id;
-            }
-            else {
-                if constexpr (std::is_pointer_v<std::remove_reference_t<decltype(f)>>) {
-                    job->m_pfvoid = f;
-                }
-                else {
-                    job->m_function = f; //std::function<void(void)> or a lambda
-                    job->m_pfvoid = nullptr;
-                }
-            }
-
-            if (!job->m_function && !job->m_pfvoid) {
-                std::cout << "Empty function\n";
-                std::terminate();
+        uint32_t clear() {
+            uint32_t res = 0;
+            JOB* job = pop();                   //deallocate jobs that run a function
+            while (job != nullptr) {            //because they were allocated by the JobSystem
+                auto& da = job->get_deallocator(); //get deallocator
+                da.deallocate(job);             //deallocate the memory
+                job = pop();                    //get next entry
+                ++res;
             }
-            return job;
+            return res;
         }
 
-
-    public:
-
         /**
-        * \brief JobSystem class constructor.
-        * \param[in] threadCount Number of threads in the system.
-        * \param[in] start_idx Number of first thread, if 1 then the main thread should enter as thread 0.
-        * \param[in] mr The memory resource to use for allocating Jobs.
+        * \brief Test whether the queue is empty, can be called by any thread.
+        * \returns true if no jobs are in the queue.
         */
-        JobSystem(thread_count_t threadCount = thread_count_t(0), thread_index_t start_idx = thread_index_t(0)
-            , n_pmr::memory_resource* mr = n_pmr::new_delete_resource()) noexcept {
+        bool empty() noexcept {
+            return m_head.load(std::memory_order::acquire) == &m_stub
+                && m_stub.m_next.load(std::memory_order::acquire) == nullptr;
+        }
 
-            if (m_init_counter > 0) [[likely]] return;
-            auto cnt = m_init_counter.fetch_add(1);
-            if (cnt > 0) return;
+        /**
+        * \brief Any thread pushes a job onto the queue.
+        * \param[in] job The job to be pushed into the queue.
+        */
+        void push(JOB* job) noexcept {
+            push_node(job);
+        };
 
-            m_mr = mr;
-            m_start_idx = start_idx;
-            m_terminate = false;
-            m_terminated = false;
+        /**
+        * \brief Any thread pushes a chain of jobs linked through m_next with one atomic exchange.
+        * \param[in] first First job of the chain.
+        * \param[in] last Last job of the chain.
+        * \param[in] num Number of jobs in the chain, not needed since the chain is linked in as a whole.
+        */
+        void push(JOB* first, JOB* last, [[maybe_unused]] uint32_t num) noexcept {
+            last->m_next.store(nullptr, std::memory_order::relaxed);
+            Queuable* prev = m_head.exchange(last, std::memory_order::acq_rel);
+            prev->m_next.store(first, std::memory_order::release);
+        };
 
-            m_thread_count = threadCount.value;
-            if (m_thread_count <= 0) {
-                m_thread_count = std::thread::hardware_concurrency();		///< main thread is also running
+        /**
+        * \brief The owner pops the job that was pushed first.
+        * \returns a job or nullptr. nullptr is also returned if a producer is in the middle of a push.
+        */
+        JOB* pop() noexcept {
+            Queuable* tail = m_tail;
+            Queuable* next = tail->m_next.load(std::memory_order::acquire);
+            if (tail == &m_stub) {                  //skip the stub node
+                if (next == nullptr) return nullptr;
+                m_tail = next;
+                tail = next;
+                next = next->m_next.load(std::memory_order::acquire);
             }
-            if (m_thread_count == 0) {
-                m_thread_count = 1;
+            if (next != nullptr) {                  //tail has a successor, so it can be removed
+                m_tail = next;
+                return (JOB*)tail;
             }
-
-            for (uint32_t i = 0; i < m_thread_count; i++) {
-                m_global_queues.push_back(JobQueue<Job_base>());     //global job queue
-                m_local_queues.push_back(JobQueue<Job_base>());     //local job queue
-                m_cv.emplace_back(std::make_unique<std::condition_variable>());
-                m_mutex.emplace_back(std::make_unique<std::mutex>());
+            if (tail != m_head.load(std::memory_order::acquire)) {
+                return nullptr;                     //a producer has not yet linked its job
             }
-
-            for (uint32_t i = start_idx.value; i < m_thread_count; i++) {
-                //std::cout << "Starting thread " << i << std::endl;
-                m_threads.push_back(std::thread(&JobSystem::thread_task, this, thread_index_t(i) ));	//spawn the pool threads
-                m_threads[i].detach();
+            push_node(&m_stub);                     //tail is the last job, put the stub behind it
+            next = tail->m_next.load(std::memory_order::acquire);
+            if (next != nullptr) {
+                m_tail = next;
+                return (JOB*)tail;
             }
-
-            m_logs.resize(m_thread_count, n_pmr::vector<JobLog>{mr});    //make room for the log files
+            return nullptr;
         };
 
+    };
+
+
+    /**
+    * \brief Lock-free work-stealing deque (Chase-Lev) with a growable ring buffer.
+    *
+    * Only the owning thread may push() and pop(). It works at the bottom end in LIFO
+    * order without any locks. Other threads call steal() to take jobs from the top end
+    * in FIFO order, competing with a single CAS. Since thieves might still read
+    * from a ring buffer after it has been replaced by a larger one, old buffers
+    * are kept until the queue is destroyed.
+    */
+    template<typename JOB = Queuable>
+    requires std::is_base_of_v<Queuable, JOB >
+    class alignas(cache_line_size) WorkQueue {
+        static inline const int64_t c_initial_capacity = 1 << 8; ///<initial number of slots in the ring buffer
 
         /**
-        * \brief Test whether the job system has been started yet.
-        * \returns true if the instance exists, else false.
+        * \brief Ring buffer holding the jobs of the deque, capacity is a power of 2.
         */
-        static bool is_instance_created() noexcept {
-            return m_current_job != nullptr;
+        struct Ring {
+            int64_t                                 m_mask;     //capacity - 1
+            std::unique_ptr<std::atomic<JOB*>[]>    m_data;     //the slots
+
+            Ring(int64_t capacity) noexcept : m_mask(capacity - 1), m_data(new std::atomic<JOB*>[capacity]) {};
+            int64_t capacity() noexcept { return m_mask + 1; }
+            void put(int64_t i, JOB* job) noexcept { m_data[i & m_mask].store(job, std::memory_order::relaxed); }
+            JOB* get(int64_t i) noexcept { return m_data[i & m_mask].load(std::memory_order::relaxed); }
         };
 
-        JobSystem(const JobSystem&) = delete;				// non-copyable,
-        JobSystem& operator=(const JobSystem&) = delete;
-        JobSystem(JobSystem&&) = default;					// but movable
-        JobSystem& operator=(JobSystem&&) = default;
-        ~JobSystem() = default;
-
-        void on_finished(Job* job) noexcept;            //called when the job finishes, i.e. all children have finished
+        alignas(cache_line_size) std::atomic<int64_t>   m_top = 0;      //thieves steal here
+        alignas(cache_line_size) std::atomic<int64_t>   m_bottom = 0;   //owner pushes and pops here, on its own cache line
+        alignas(cache_line_size) std::atomic<Ring*>     m_ring;         //current ring buffer, read mostly
+        std::vector<std::unique_ptr<Ring>>              m_rings;        //all ring buffers ever used, freed on destruction
 
         /**
-        * \brief Child tells its parent that it has finished.
-        *
-        * A child that finished calls this function for its parent, thus decreasing
-        * the number of left children by one. If the last one finishes (including the
-        * parent itself) then the parent also finishes (and may call its own parent).
-        * Note that a Job is also its own child, so it must have returned from
-        * its function before on_finished() is called. Note that a Job is also its own
-        * child so that the Job can only finish after its function has returned.
+        * \brief Replace the ring buffer by one with twice the capacity. Called only by the owner.
+        * \param[in] ring The current ring buffer.
+        * \param[in] top Current top index.
+        * \param[in] bottom Current bottom index.
+        * \returns the new ring buffer.
         */
-        inline bool child_finished(Job_base* job) noexcept {
-            uint32_t num = job->m_children.fetch_sub(1);        //one less child
-            if (num == 1) {                                     //was it the last child?
-
-                if (job->is_function()) {            //Jobs call always on_finished()
-                    on_finished((Job*)job);     //if yes then finish this job
-                }
-                else {
-                    schedule_job(job);   //a coro just gets scheduled again so it can go on
-                }
-                return true;
+        Ring* grow(Ring* ring, int64_t top, int64_t bottom) noexcept {
+            m_rings.push_back(std::make_unique<Ring>(ring->capacity() * 2));
+            Ring* bigger = m_rings.back().get();
+            for (int64_t i = top; i < bottom; ++i) {
+                bigger->put(i, ring->get(i));
             }
-            return false;
+            m_ring.store(bigger, std::memory_order::release);
+            return bigger;
         }
 
-        /**
-        * \brief Every thread runs in this function
-        * \param[in] threadIndex Number of this thread
-        */
-        void thread_task(thread_index_t threadIndex = thread_index_t(0) ) noexcept {
-            constexpr uint32_t NOOP = 1<<8;                                   //number of empty loops until garbage collection
-            thread_local static uint32_t noop_counter = 0;
-            m_thread_index = threadIndex;	                                //Remember your own thread index number
-            static std::atomic<uint32_t> thread_counter = m_thread_count.load();	//Counted down when started
+    public:
 
-            thread_counter--;			                                    //count down
-            while (thread_counter.load() > 0) {}	                        //Continue only if all threads are running
+        WorkQueue() noexcept {      ///<WorkQueue class constructor
+            m_rings.push_back(std::make_unique<Ring>(c_initial_capacity));
+            m_ring = m_rings.back().get();
+        };
 
-            uint32_t next = rand() % m_thread_count;                        //initialize at random position for stealing
-            auto start = high_resolution_clock::now();
+        WorkQueue(const WorkQueue<JOB>& queue) noexcept : WorkQueue() {};
 
-            std::unique_lock<std::mutex> lk(*m_mutex[m_thread_index.value]);
+        ~WorkQueue() {}  //destructor
 
-            while (!m_terminate) {			                                //Run until the job system is terminated
-                m_current_job = m_local_queues[m_thread_index.value].pop();       //try get a job from the local queue
-                if (m_current_job == nullptr) {
-                    m_current_job = m_global_queues[m_thread_index.value].pop();  //try get a job from the global queue
-                }
-                int num_try = m_thread_count - 1;
-                while (m_current_job == nullptr && --num_try >0) {                             //try steal job from another thread
-                    if (++next >= m_thread_count) next = 0;
-                    m_current_job = m_global_queues[next].pop();
-                }
+        /**
+        * \brief Deallocate all Jobs in the queue. Must be called by the owner.
+        */
+        uint32_t clear() {
+            uint32_t res = size();
+            JOB* job = pop();                   //deallocate jobs that run a function
+            while (job != nullptr) {            //because they were allocated by the JobSystem
+                auto& da = job->get_deallocator(); //get deallocator
+                da.deallocate(job);             //deallocate the memory
+                job = pop();                    //get next entry
+            }
+            return res;
+        }
+
+        /**
+        * \brief Get the number of jobs currently in the queue.
+        * \returns the approximate number of jobs currently in the queue.
+        */
+        uint32_t size() noexcept {
+            int64_t b = m_bottom.load(std::memory_order::relaxed);
+            int64_t t = m_top.load(std::memory_order::relaxed);
+            return b > t ? (uint32_t)(b - t) : 0;
+        }
+
+        /**
+        * \brief Owner pushes a job onto the bottom of the deque.
+        * \param[in] job The job to be pushed into the queue.
+        * \returns true if the deque was empty before.
+        */
+        bool push(JOB* job) noexcept {
+            int64_t b = m_bottom.load(std::memory_order::relaxed);
+            int64_t t = m_top.load(std::memory_order::acquire);
+            Ring* ring = m_ring.load(std::memory_order::relaxed);
+            if (b - t > ring->m_mask) {                 //ring is full
+                ring = grow(ring, t, b);
+            }
+            ring->put(b, job);
+            std::atomic_thread_fence(std::memory_order::release);
+            m_bottom.store(b + 1, std::memory_order::relaxed);
+            return b <= t;
+        };
+
+        /**
+        * \brief Owner pushes a chain of jobs linked through m_next, publishing them all at once.
+        * \param[in] first First job of the chain.
+        * \param[in] last Last job of the chain.
+        * \param[in] num Number of jobs in the chain.
+        * \returns true if the deque was empty before.
+        */
+        bool push(JOB* first, JOB* last, uint32_t num) noexcept {
+            int64_t b = m_bottom.load(std::memory_order::relaxed);
+            int64_t t = m_top.load(std::memory_order::acquire);
+            Ring* ring = m_ring.load(std::memory_order::relaxed);
+            while (b - t + (int64_t)num > ring->capacity()) {   //make room for all jobs
+                ring = grow(ring, t, b);
+            }
+            JOB* job = first;
+            for (uint32_t i = 0; i < num; ++i) {
+                ring->put(b + i, job);
+                job = (JOB*)job->m_next.load(std::memory_order::relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order::release);
+            m_bottom.store(b + num, std::memory_order::relaxed);
+            return b <= t;
+        };
+
+        /**
+        * \brief Owner pops a job from the bottom of the deque (LIFO).
+        * \returns a job or nullptr.
+        */
+        JOB* pop() noexcept {
+            int64_t b = m_bottom.load(std::memory_order::relaxed) - 1;
+            Ring* ring = m_ring.load(std::memory_order::relaxed);
+            m_bottom.store(b, std::memory_order::relaxed);
+            std::atomic_thread_fence(std::memory_order::seq_cst);
+            int64_t t = m_top.load(std::memory_order::relaxed);
+
+            if (t > b) {                                //queue was empty
+                m_bottom.store(b + 1, std::memory_order::relaxed);
+                return nullptr;
+            }
+            JOB* job = ring->get(b);
+            if (t == b) {                               //last job, race against thieves
+                if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order::seq_cst, std::memory_order::relaxed)) {
+                    job = nullptr;                      //a thief was faster
+                }
+                m_bottom.store(b + 1, std::memory_order::relaxed);
+            }
+            return job;
+        };
+
+        /**
+        * \brief Any thread steals a job from the top of the deque (FIFO).
+        * \returns a job or nullptr if the queue was empty or another thief was faster.
+        */
+        JOB* steal() noexcept {
+            int64_t t = m_top.load(std::memory_order::acquire);
+            std::atomic_thread_fence(std::memory_order::seq_cst);
+            int64_t b = m_bottom.load(std::memory_order::acquire);
+            if (t >= b) return nullptr;                 //queue is empty
+
+            Ring* ring = m_ring.load(std::memory_order::acquire);
+            JOB* job = ring->get(t);
+            if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order::seq_cst, std::memory_order::relaxed)) {
+                return nullptr;                         //lost the race
+            }
+            return job;
+        };
+
+    };
+
+
+    /**
+    * \brief Queue that always returns the job with the earliest deadline (EDF).
+    *
+    * The jobs are kept in a binary min-heap ordered by Job_base::m_deadline. Like JobQueue
+    * it allows for multiple producers multiple consumers and uses a lightweight atomic flag as lock.
+    * The heap is allocated from a memory resource and reserved up front, so pushing does not
+    * allocate while the queue is locked unless more jobs are queued than reserved.
+    */
+    template<typename JOB = Job_base>
+    requires std::is_base_of_v<Job_base, JOB >
+    class alignas(cache_line_size) DeadlineQueue {
+        std::atomic_flag        m_lock = ATOMIC_FLAG_INIT;  //for locking the queue
+        n_pmr::vector<JOB*>     m_heap;                     //jobs ordered by deadline
+        std::atomic<uint32_t>   m_size = 0;                 //number of entries, can be read without lock
+
+        static bool later(JOB* a, JOB* b) noexcept { return a->m_deadline > b->m_deadline; }   //min-heap order
+
+    public:
+
+        /**
+        * \brief DeadlineQueue class constructor.
+        * \param[in] mr Memory resource for the heap.
+        * \param[in] capacity Number of jobs to reserve room for.
+        */
+        DeadlineQueue(n_pmr::memory_resource* mr = n_pmr::new_delete_resource(), uint32_t capacity = 0) noexcept : m_heap{ mr } {
+            m_heap.reserve(capacity);
+        };
+
+        DeadlineQueue(const DeadlineQueue<JOB>& queue) noexcept : DeadlineQueue(queue.m_heap.get_allocator().resource(), (uint32_t)queue.m_heap.capacity()) {};
+
+        ~DeadlineQueue() {}  //destructor
+
+        /**
+        * \brief Deallocate all Jobs in the queue.
+        */
+        uint32_t clear() {
+            uint32_t res = 0;
+            JOB* job = pop();                   //deallocate jobs that run a function
+            while (job != nullptr) {            //because they were allocated by the JobSystem
+                auto& da = job->get_deallocator(); //get deallocator
+                da.deallocate(job);             //deallocate the memory
+                job = pop();                    //get next entry
+                ++res;
+            }
+            return res;
+        }
+
+        /**
+        * \brief Get the number of jobs currently in the queue.
+        * \returns the number of jobs currently in the queue.
+        */
+        uint32_t size() noexcept {
+            return m_size.load(std::memory_order::relaxed);
+        }
+
+        /**
+        * \brief Pushes a job into the queue.
+        * \param[in] job The job to be pushed into the queue.
+        * \returns true if the queue was empty before.
+        */
+        bool push(JOB* job) {
+            while (m_lock.test_and_set(std::memory_order::acquire));  // acquire lock
+            bool was_empty = m_heap.empty();
+            m_heap.push_back(job);
+            std::push_heap(m_heap.begin(), m_heap.end(), later);
+            m_size.store((uint32_t)m_heap.size(), std::memory_order::relaxed);
+            m_lock.clear(std::memory_order::release); //release lock
+            return was_empty;
+        };
+
+        /**
+        * \brief Pushes a chain of jobs linked through m_next into the queue with one lock operation.
+        *
+        * The jobs are appended and the heap is rebuilt once.
+        *
+        * \param[in] first First job of the chain.
+        * \param[in] last Last job of the chain, the chain is walked by its length.
+        * \param[in] num Number of jobs in the chain.
+        * \returns true if the queue was empty before.
+        */
+        bool push(JOB* first, [[maybe_unused]] JOB* last, uint32_t num) {
+            while (m_lock.test_and_set(std::memory_order::acquire));  // acquire lock
+            bool was_empty = m_heap.empty();
+            JOB* job = first;
+            for (uint32_t i = 0; i < num; ++i) {
+                m_heap.push_back(job);
+                job = (JOB*)job->m_next.load(std::memory_order::relaxed);
+            }
+            std::make_heap(m_heap.begin(), m_heap.end(), later);
+            m_size.store((uint32_t)m_heap.size(), std::memory_order::relaxed);
+            m_lock.clear(std::memory_order::release); //release lock
+            return was_empty;
+        };
+
+        /**
+        * \brief Pops the job with the earliest deadline.
+        * \returns a job or nullptr.
+        */
+        JOB* pop() {
+            if (m_size.load(std::memory_order::relaxed) == 0) return nullptr;
+
+            while (m_lock.test_and_set(std::memory_order::acquire));  // acquire lock
+            JOB* job = nullptr;
+            if (!m_heap.empty()) {
+                std::pop_heap(m_heap.begin(), m_heap.end(), later);
+                job = m_heap.back();
+                m_heap.pop_back();
+                m_size.store((uint32_t)m_heap.size(), std::memory_order::relaxed);
+            }
+            m_lock.clear(std::memory_order::release);   //release lock
+            return job;
+        };
+
+    };
+
+
+    /**
+    * \brief Parking lot for idle threads.
+    *
+    * Each thread parks on its own mutex and condition variable, so waking up one thread
+    * does not disturb the others. Parked threads are kept on an idle stack, and producers
+    * wake up only as many of them as they have new jobs for.
+    */
+    class ParkingLot {
+        static inline const uint32_t c_running = 0;     ///<thread is looking for jobs
+        static inline const uint32_t c_parked = 1;      ///<thread sleeps or is about to sleep
+        static inline const uint32_t c_notified = 2;    ///<thread has been woken up
+
+        /**
+        * \brief Parking spot of one thread.
+        */
+        struct alignas(cache_line_size) spot {
+            std::mutex              m_mutex;
+            std::condition_variable m_cv;
+            std::atomic<uint32_t>   m_state = c_running;
+            bool                    m_on_stack = false;     //protected by m_lock of the lot
+        };
+
+        std::vector<std::unique_ptr<spot>>  m_spots;            //one spot per thread
+        std::vector<uint32_t>               m_idle;             //stack of parked threads, entries may be stale
+        std::atomic_flag                    m_lock = ATOMIC_FLAG_INIT;  //protects the stack
+        std::atomic<uint32_t>               m_num_idle = 0;     //number of parked threads
+
+        /**
+        * \brief Wake up a thread if it is parked.
+        * \param[in] s The spot of the thread.
+        * \returns true if the thread was parked and has been notified.
+        */
+        bool wake(spot& s) noexcept {
+            uint32_t expected = c_parked;
+            if (!s.m_state.compare_exchange_strong(expected, c_notified)) return false;
+            { std::lock_guard<std::mutex> lk(s.m_mutex); }  //the thread is either waiting or will see the new state
+            s.m_cv.notify_one();
+            return true;
+        }
+
+    public:
+
+        /**
+        * \brief Create the parking spots.
+        * \param[in] num Number of threads.
+        */
+        void resize(uint32_t num) {
+            for (uint32_t i = (uint32_t)m_spots.size(); i < num; ++i) {
+                m_spots.emplace_back(std::make_unique<spot>());
+            }
+            m_idle.reserve(num);
+        }
+
+        /**
+        * \brief Get the number of parked threads.
+        * \returns the number of threads that are parked.
+        */
+        uint32_t num_idle() noexcept {
+            return m_num_idle.load(std::memory_order::relaxed);
+        }
+
+        /**
+        * \brief A thread parks until it is woken up or the timeout expires.
+        * \param[in] index Index of the parking thread.
+        * \param[in] has_work Checked once after the thread announced itself, if true the thread does not sleep.
+        * \param[in] timeout Maximum time to sleep.
+        * \param[in] idle If false then the thread is not put on the idle stack, so only unpark_thread() and unpark_all() wake it up.
+        * \returns true if the thread was woken up by another thread.
+        */
+        template<typename F>
+        bool park(uint32_t index, F&& has_work, std::chrono::microseconds timeout, bool idle = true) noexcept {
+            spot& s = *m_spots[index];
+            s.m_state.store(c_parked);
+            while (m_lock.test_and_set(std::memory_order::acquire));
+            if (idle && !s.m_on_stack) {
+                m_idle.push_back(index);
+                s.m_on_stack = true;
+            }
+            else if (!idle && s.m_on_stack) {   //remove a stale entry, unpark() must not pick this thread
+                std::erase(m_idle, index);
+                s.m_on_stack = false;
+            }
+            m_lock.clear(std::memory_order::release);
+            m_num_idle.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order::seq_cst);   //pairs with the fence in JobSystem::wake_threads()
+
+            if (!has_work()) {
+                std::unique_lock<std::mutex> lk(s.m_mutex);
+                s.m_cv.wait_for(lk, timeout, [&]() { return s.m_state.load() != c_parked; });
+            }
+            m_num_idle.fetch_sub(1);
+            return s.m_state.exchange(c_running) == c_notified;
+        }
+
+        /**
+        * \brief Wake up parked threads from the idle stack.
+        * \param[in] num Maximum number of threads to wake up.
+        * \returns the number of threads that have been woken up.
+        */
+        uint32_t unpark(uint32_t num) noexcept {
+            uint32_t res = 0;
+            while (res < num && m_num_idle.load(std::memory_order::relaxed) > 0) {
+                while (m_lock.test_and_set(std::memory_order::acquire));
+                if (m_idle.empty()) {
+                    m_lock.clear(std::memory_order::release);
+                    break;
+                }
+                uint32_t index = m_idle.back();
+                m_idle.pop_back();
+                m_spots[index]->m_on_stack = false;
+                m_lock.clear(std::memory_order::release);
+                if (wake(*m_spots[index])) ++res;       //stale entries are skipped
+            }
+            return res;
+        }
+
+        /**
+        * \brief Wake up a specific thread if it is parked.
+        * \param[in] index Index of the thread.
+        * \returns true if the thread has been woken up.
+        */
+        bool unpark_thread(uint32_t index) noexcept {
+            if (m_spots[index]->m_state.load(std::memory_order::relaxed) != c_parked) return false;
+            return wake(*m_spots[index]);
+        }
+
+        /**
+        * \brief Wake up all parked threads.
+        */
+        void unpark_all() noexcept {
+            for (auto& s : m_spots) wake(*s);
+        }
+    };
+
+
+    /**
+    * \brief Describes what a thread does if it does not find a job.
+    *
+    * The thread first searches again up to m_spin_count times. Between two searches it
+    * executes pause instructions, their number doubles each time up to m_max_backoff. Then the
+    * thread parks until it is woken up, but at most for m_park_timeout. In adaptive mode each
+    * thread measures the time between jobs and spins only if the next job is expected to arrive
+    * before m_spin_count searches are over, else it parks right away.
+    */
+    struct IdlePolicy {
+        uint32_t                    m_spin_count = 1 << 7;  ///<number of searches before parking, upper bound in adaptive mode
+        uint32_t                    m_max_backoff = 1 << 4; ///<maximum number of pause instructions between two searches
+        std::chrono::microseconds   m_park_timeout = std::chrono::microseconds(1000); ///<maximum park time, a safety net for lost wake-ups
+        bool                        m_adaptive = false;     ///<tune spinning from the measured job inter-arrival times
+    };
+
+
+    /**
+    * \brief Describes how worker threads are pinned to logical CPUs.
+    *
+    * compact fills all SMT siblings of a core before the next core is used, scatter first uses one logical CPU
+    * of each core (alternating the sockets), then the siblings. skip_smt uses only one logical CPU per core.
+    * Worker i runs on the i-th CPU of this order, wrapping around if there are more workers than CPUs.
+    */
+    struct AffinityPolicy {
+        enum mode_t { none, compact, scatter, skip_smt };
+        mode_t              m_mode = none;  ///<preset, none means that the OS places the threads
+        std::vector<int>    m_cpus;         ///<if not empty, worker i runs on logical CPU m_cpus[i % size], overrides m_mode
+
+        /**
+        * \brief Compute the logical CPU of each worker thread.
+        * \param[in] num Number of worker threads.
+        * \returns the CPU of each thread, -1 if the thread is not pinned.
+        */
+        std::vector<int> cpus(uint32_t num) const {
+            std::vector<int> order = m_cpus;
+            if (order.empty() && m_mode != none) {
+                auto topology = cpu_topology();
+                if (m_mode == skip_smt) {
+                    std::erase_if(topology, [](auto& c) { return c.m_sibling > 0; });
+                }
+                std::sort(topology.begin(), topology.end(), [&](auto& a, auto& b) {
+                    if (m_mode == scatter) {
+                        return std::tie(a.m_sibling, a.m_core, a.m_package) < std::tie(b.m_sibling, b.m_core, b.m_package);
+                    }
+                    return std::tie(a.m_package, a.m_core, a.m_sibling) < std::tie(b.m_package, b.m_core, b.m_sibling);
+                });
+                for (auto& c : topology) order.push_back(c.m_cpu);
+            }
+            std::vector<int> res(num, -1);
+            for (uint32_t i = 0; i < num && !order.empty(); ++i) res[i] = order[i % order.size()];
+            return res;
+        }
+    };
+
+
+    /**
+    * \brief Describes how the number of active worker threads of a group follows the load.
+    *
+    * Only the first threads of a group are active, the others park and are not stolen from. In automatic mode
+    * a worker that finds more than m_grow_depth jobs in its own queues activates one more thread of its group,
+    * and the last active thread of a group deactivates itself after it has been idle for m_shrink_idle.
+    * The number of active threads stays between m_min_threads and m_max_threads, 0 means all threads of the group.
+    */
+    struct ElasticPolicy {
+        bool                        m_auto = false;         ///<if true then threads are activated and deactivated automatically
+        uint32_t                    m_min_threads = 1;      ///<automatic mode, minimum number of active threads of a group
+        uint32_t                    m_max_threads = 0;      ///<automatic mode, maximum number of active threads of a group, 0 means all
+        uint32_t                    m_grow_depth = 16;      ///<automatic mode, queued jobs of a worker that activate another thread
+        std::chrono::microseconds   m_shrink_idle = std::chrono::microseconds(100'000); ///<automatic mode, idle time that deactivates a thread
+    };
+
+
+    /**
+    * \brief A group of worker threads, e.g. for compute, blocking I/O or rendering.
+    *
+    * Jobs whose type is m_type are run only by the threads of the group, and the threads
+    * of a group steal only from each other. Jobs with other types run in the first group.
+    */
+    struct WorkerGroup {
+        thread_type_t   m_type;             ///<jobs of this type are run by this group
+        thread_count_t  m_count;            ///<number of threads, if empty or 0 then the number of hardware threads
+        std::string     m_name = "";        ///<name of the group, also used as type name for logging
+    };
+
+
+    /**
+    * \brief Scheduling counters of one or all threads, can be used to check scheduling policies.
+    */
+    struct JobStatistics {
+        uint64_t m_steal_attempts = 0;  ///<number of queues a thief tried to steal from
+        uint64_t m_steals = 0;          ///<number of successful steal operations
+        uint64_t m_stolen_jobs = 0;     ///<number of jobs taken by successful steal operations
+        uint64_t m_remote_steals = 0;   ///<number of successful steal operations from threads on other NUMA nodes
+        uint64_t m_parks = 0;           ///<number of times a thread went to sleep
+        uint64_t m_wakeups = 0;         ///<number of times a sleeping thread was woken up by another thread
+        uint64_t m_deadline_jobs = 0;   ///<number of finished jobs that had a deadline
+        uint64_t m_deadline_misses = 0; ///<number of jobs that finished after their deadline
+        uint64_t m_inline_continuations = 0; ///<number of continuations that were run right away, bypassing the queues
+        uint64_t m_local_jobs = 0;      ///<wait statistics: number of jobs taken from the local queues, i.e. pinned jobs
+        uint64_t m_local_wait = 0;      ///<wait statistics: sum of their times in the queues in ns
+        uint64_t m_local_max_wait = 0;  ///<wait statistics: longest time one of them waited in ns
+        uint64_t m_global_jobs = 0;     ///<wait statistics: number of jobs taken from all other queues and next slots, or stolen
+        uint64_t m_global_wait = 0;     ///<wait statistics: sum of their times in the queues in ns
+        uint64_t m_global_max_wait = 0; ///<wait statistics: longest time one of them waited in ns
+        uint64_t m_tag_chunks = 0;      ///<number of chunks of jobs pulled out of released tags
+
+        JobStatistics& operator+=(const JobStatistics& rhs) noexcept {
+            m_steal_attempts += rhs.m_steal_attempts;
+            m_steals += rhs.m_steals;
+            m_stolen_jobs += rhs.m_stolen_jobs;
+            m_remote_steals += rhs.m_remote_steals;
+            m_parks += rhs.m_parks;
+            m_wakeups += rhs.m_wakeups;
+            m_deadline_jobs += rhs.m_deadline_jobs;
+            m_deadline_misses += rhs.m_deadline_misses;
+            m_inline_continuations += rhs.m_inline_continuations;
+            m_local_jobs += rhs.m_local_jobs;
+            m_local_wait += rhs.m_local_wait;
+            m_local_max_wait = std::max(m_local_max_wait, rhs.m_local_max_wait);
+            m_global_jobs += rhs.m_global_jobs;
+            m_global_wait += rhs.m_global_wait;
+            m_global_max_wait = std::max(m_global_max_wait, rhs.m_global_max_wait);
+            m_tag_chunks += rhs.m_tag_chunks;
+            return *this;
+        }
+    };
+
+
+    /**
+    * \brief Counters of a thread. Only the thread itself writes them, any thread may read them.
+    */
+    struct alignas(cache_line_size) thread_counters {
+        std::atomic<uint64_t> m_steal_attempts = 0;
+        std::atomic<uint64_t> m_steals = 0;
+        std::atomic<uint64_t> m_stolen_jobs = 0;
+        std::atomic<uint64_t> m_remote_steals = 0;
+        std::atomic<uint64_t> m_parks = 0;
+        std::atomic<uint64_t> m_wakeups = 0;
+        std::atomic<uint64_t> m_deadline_jobs = 0;
+        std::atomic<uint64_t> m_deadline_misses = 0;
+        std::atomic<uint64_t> m_inline_continuations = 0;
+        std::atomic<uint64_t> m_local_jobs = 0;
+        std::atomic<uint64_t> m_local_wait = 0;
+        std::atomic<uint64_t> m_local_max_wait = 0;
+        std::atomic<uint64_t> m_global_jobs = 0;
+        std::atomic<uint64_t> m_global_wait = 0;
+        std::atomic<uint64_t> m_global_max_wait = 0;
+        std::atomic<uint64_t> m_tag_chunks = 0;
+
+        static void add(std::atomic<uint64_t>& counter, uint64_t n = 1) noexcept {  //single writer, so no RMW needed
+            counter.store(counter.load(std::memory_order::relaxed) + n, std::memory_order::relaxed);
+        }
+
+        static void max(std::atomic<uint64_t>& counter, uint64_t n) noexcept {
+            if (n > counter.load(std::memory_order::relaxed)) counter.store(n, std::memory_order::relaxed);
+        }
+
+        JobStatistics get() noexcept {
+            return { m_steal_attempts.load(std::memory_order::relaxed), m_steals.load(std::memory_order::relaxed)
+                , m_stolen_jobs.load(std::memory_order::relaxed), m_remote_steals.load(std::memory_order::relaxed)
+                , m_parks.load(std::memory_order::relaxed)
+                , m_wakeups.load(std::memory_order::relaxed), m_deadline_jobs.load(std::memory_order::relaxed)
+                , m_deadline_misses.load(std::memory_order::relaxed), m_inline_continuations.load(std::memory_order::relaxed)
+                , m_local_jobs.load(std::memory_order::relaxed), m_local_wait.load(std::memory_order::relaxed), m_local_max_wait.load(std::memory_order::relaxed)
+                , m_global_jobs.load(std::memory_order::relaxed), m_global_wait.load(std::memory_order::relaxed), m_global_max_wait.load(std::memory_order::relaxed)
+                , m_tag_chunks.load(std::memory_order::relaxed) };
+        }
+
+        void clear() noexcept {
+            m_steal_attempts = 0;
+            m_steals = 0;
+            m_stolen_jobs = 0;
+            m_remote_steals = 0;
+            m_parks = 0;
+            m_wakeups = 0;
+            m_deadline_jobs = 0;
+            m_deadline_misses = 0;
+            m_inline_continuations = 0;
+            m_local_jobs = 0;
+            m_local_wait = 0;
+            m_local_max_wait = 0;
+            m_global_jobs = 0;
+            m_global_wait = 0;
+            m_global_max_wait = 0;
+            m_tag_chunks = 0;
+        }
+    };
+
+
+    /**
+    * \brief A chain of jobs linked through m_next, e.g. collected during a batch.
+    */
+    struct job_chain {
+        Job_base*   m_first = nullptr;  //first job of the chain
+        Job_base*   m_last = nullptr;   //last job of the chain
+        uint32_t    m_size = 0;         //number of jobs in the chain
+
+        void push(Job_base* job) noexcept {     //append a job to the chain
+            job->m_next.store(nullptr, std::memory_order::relaxed);
+            if (m_last == nullptr) m_first = job;
+            else m_last->m_next.store(job, std::memory_order::relaxed);
+            m_last = job;
+            ++m_size;
+        }
+
+        void clear() noexcept {                 //forget all jobs
+            m_first = m_last = nullptr;
+            m_size = 0;
+        }
+    };
+
+
+    /**
+    * \brief Single-entry LIFO slot of a worker holding the job that became ready last.
+    *
+    * The owner runs this job next, while its data is still in the cache. Thieves may take it only
+    * if it has waited for longer than a grace period. The owner only counts its puts, and the clock
+    * is read by the thieves, which start the grace period when they first see a put.
+    */
+    struct alignas(cache_line_size) NextSlot {
+        std::atomic<Job_base*>  m_job = nullptr;    //the job, or nullptr
+        std::atomic<uint64_t>   m_puts = 0;         //number of puts, written only by the owner
+        std::atomic<uint64_t>   m_seen = 0;         //number of puts when a thief looked last
+        std::atomic<int64_t>    m_time = 0;         //time when a thief first saw the current put, in ns
+
+        static int64_t now() noexcept {             //current time in ns
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+        }
+
+        /**
+        * \brief Owner puts a job into the slot.
+        * \param[in] job The job.
+        * \returns the job that was in the slot before, or nullptr.
+        */
+        Job_base* put(Job_base* job) noexcept {
+            m_puts.store(m_puts.load(std::memory_order::relaxed) + 1, std::memory_order::relaxed);
+            return m_job.exchange(job, std::memory_order::acq_rel);
+        }
+
+        /**
+        * \brief Owner takes the job out of the slot.
+        * \returns the job, or nullptr.
+        */
+        Job_base* take() noexcept {
+            if (m_job.load(std::memory_order::relaxed) == nullptr) return nullptr;
+            return m_job.exchange(nullptr, std::memory_order::acq_rel);
+        }
+
+        /**
+        * \brief A thief takes the job if it has waited for longer than the grace period, counted from
+        * the first time a thief saw it.
+        * \param[in] grace The grace period in ns.
+        * \returns the job, or nullptr.
+        */
+        Job_base* steal(int64_t grace) noexcept {
+            Job_base* job = m_job.load(std::memory_order::acquire);
+            if (job == nullptr) return nullptr;
+            uint64_t puts = m_puts.load(std::memory_order::relaxed);
+            if (m_seen.load(std::memory_order::acquire) != puts) {     //a new job, start its grace period
+                m_time.store(now(), std::memory_order::relaxed);
+                m_seen.store(puts, std::memory_order::release);
+                return nullptr;
+            }
+            if (now() - m_time.load(std::memory_order::relaxed) < grace) return nullptr;
+            return m_job.compare_exchange_strong(job, nullptr, std::memory_order::acq_rel) ? job : nullptr;
+        }
+    };
+
+
+    /**
+    * \brief Queue of a tag, sharded by the producing thread.
+    *
+    * Each worker pushes into its own shard, and all other threads share the last shard,
+    * so threads that fill the same tag at the same time do not contend for one lock.
+    */
+    struct TagQueue {
+        std::unique_ptr<JobQueue<Job_base>[]>   m_shards;       //one queue per worker, plus one for all other threads
+        uint32_t                                m_num_shards;   //number of shards
+
+        TagQueue(uint32_t num_shards) noexcept : m_shards{ std::make_unique<JobQueue<Job_base>[]>(num_shards) }, m_num_shards{ num_shards } {}
+
+        /**
+        * \brief Push a job into the shard of a thread.
+        * \param[in] job The job.
+        * \param[in] index Index of the pushing thread, or -1 if it is not a worker.
+        */
+        void push(Job_base* job, int32_t index) noexcept {
+            m_shards[index >= 0 && index < (int32_t)m_num_shards - 1 ? index : m_num_shards - 1].push(job);
+        }
+
+        /**
+        * \brief Get the number of jobs in each shard, e.g. when the tag is released.
+        * \param[out] sizes One entry per shard, receives the number of jobs in the shard.
+        * \returns the number of jobs in all shards.
+        */
+        uint32_t size(std::atomic<int32_t>* sizes) noexcept {
+            uint32_t res = 0;
+            for (uint32_t i = 0; i < m_num_shards; ++i) {
+                uint32_t size = m_shards[i].size();
+                sizes[i].store((int32_t)size, std::memory_order::relaxed);
+                res += size;
+            }
+            return res;
+        }
+    };
+
+
+    /**
+    * \brief Thread-safe registry that maps tags to their queues.
+    *
+    * Tags below c_small_tags are looked up in a fixed array without locking. Other tags are kept
+    * in a map that is guarded by a reader/writer lock, so lookups of existing tags only share the lock.
+    * Registering a tag beforehand keeps the allocation off the scheduling path. Queues live until the registry is destroyed.
+    */
+    class TagRegistry {
+    public:
+        static inline const int32_t c_small_tags = 1 << 8;    ///<tags below this value use the fast path
+
+        ~TagRegistry() {
+            for (auto& entry : m_small) delete entry.load(std::memory_order::relaxed);
+        }
+
+        /**
+        * \brief Get the queue of a tag.
+        * \param[in] tg The tag.
+        * \returns the queue, or nullptr if the tag has no queue yet.
+        */
+        TagQueue* get(tag_t tg) noexcept {
+            if (tg.value < 0) return nullptr;
+            if (tg.value < c_small_tags) return m_small[tg.value].load(std::memory_order::acquire);
+            std::shared_lock lock(m_mutex);
+            auto it = m_large.find(tg);
+            return it != m_large.end() ? it->second.get() : nullptr;
+        }
+
+        /**
+        * \brief Get the queue of a tag, and create it if the tag has none yet.
+        * \param[in] tg The tag.
+        * \param[in] num_shards Number of shards of a new queue.
+        * \returns the queue.
+        */
+        TagQueue* get_or_create(tag_t tg, uint32_t num_shards) {
+            TagQueue* queue = get(tg);
+            if (queue != nullptr) return queue;
+            if (tg.value < c_small_tags) {
+                auto created = std::make_unique<TagQueue>(num_shards);
+                if (m_small[tg.value].compare_exchange_strong(queue, created.get(), std::memory_order::acq_rel)) return created.release();
+                return queue;                   //another thread was faster
+            }
+            std::unique_lock lock(m_mutex);
+            auto& entry = m_large[tg];
+            if (!entry) entry = std::make_unique<TagQueue>(num_shards);
+            return entry.get();
+        }
+
+    private:
+        std::array<std::atomic<TagQueue*>, c_small_tags>                m_small{};  //queues of the small tags
+        std::shared_mutex                                               m_mutex;    //protects m_large
+        std::unordered_map<tag_t, std::unique_ptr<TagQueue>, tag_t::hash> m_large;  //queues of all other tags
+    };
+
+
+    /**
+    * \brief The main JobSystem class manages the whole VGJS job system.
+    *
+    * The JobSystem starts N threads and provides them with data structures.
+    * It can add new jobs, and wait until they are done.
+    */
+    class JobSystem {
+        static inline const uint32_t c_queue_capacity = 1<<10; ///<save at most N Jobs for recycling
+        static inline const bool c_enable_logging = false;
+        static inline const uint32_t c_max_steal = 1<<10;     ///<steal at most N jobs at once in steal half mode
+        static inline const uint32_t c_num_priorities = 3;    ///<number of priority classes, each has its own queues
+        static inline const int64_t c_next_grace = 50'000;    ///<thieves take the job in a next slot only after N ns
+        static inline const uint32_t c_max_yield = 1<<6;      ///<a yielding job lets at most N jobs run, so it makes progress itself
+        static inline const uint32_t c_max_wait_depth = 1<<4; ///<a worker in more than N nested waits helps only with the jobs it waits for
+        static inline const uint32_t c_grow_interval = 1<<4;  ///<in automatic elastic mode a worker looks at its queue lengths every N jobs
+        static inline const uint32_t c_tag_chunk = 1<<8;      ///<a released tag is distributed in chunks of N jobs
+
+        template<typename PT, typename... Ts> friend struct awaitable_tuple;    //transfers to a single child coro right away
+        friend n_exp::coroutine_handle<> resume_parent(Job_base* parent) noexcept; //resumes or schedules a parent coro
+
+    private:
+        static inline std::atomic<uint64_t>             m_init_counter = 0;
+        static inline n_pmr::memory_resource*           m_mr;                   ///<use to allocate/deallocate Jobs
+        static inline std::vector<std::thread>	        m_threads;	            ///<array of thread structures
+        static inline std::atomic<uint32_t>   		    m_thread_count = 0;     ///<number of threads in the pool
+        static inline std::atomic<bool>                 m_terminated = false;   ///<flag set true when the last thread has exited
+        static inline thread_index_t				    m_start_idx;            ///<idx of first thread that is created
+        static inline std::atomic<uint32_t>             m_starting = 0;         ///<number of created threads that are not running yet
+        static inline std::atomic<uint32_t>             m_workers = 0;          ///<number of workers that have not exited, the last one sets m_terminated
+        static inline thread_local thread_index_t	    m_thread_index = thread_index_t{};  ///<each thread has its own number
+        static inline std::atomic<bool>				    m_terminate = false;	///<Flag for terminating the pool
+        static inline std::atomic<uint32_t>             m_worker_waits = 0;     ///<number of workers in wait(), the pool is terminated only after they have returned
+        static inline thread_local Job_base*            m_current_job = nullptr;///<Pointer to the current job of this thread0
+        static inline std::vector<std::array<WorkQueue<Job_base>, c_num_priorities>>  m_global_queues; ///<each thread has its work stealing deques, single produce, multiple consume
+        static inline std::vector<std::array<JobQueue<Job_base>, c_num_priorities>>   m_inject_queues; ///<jobs scheduled from outside the pool, multiple produce, multiple consume
+        static inline std::vector<std::array<LocalQueue<Job_base>, c_num_priorities>> m_local_queues;  ///<each thread has its own Job queues, multiple produce, single consume
+        static inline std::vector<std::array<DeadlineQueue<Job_base>, c_num_priorities>> m_deadline_queues; ///<jobs with deadlines in deadline scheduling mode, multiple produce, multiple consume
+        static inline std::vector<std::unique_ptr<NextSlot>>  m_next_slots;   ///<each thread runs the job that became ready last next
+        static inline std::vector<std::unique_ptr<std::atomic<int64_t>>> m_high_jobs;   ///<number of queued high priority jobs of each worker group that are not pinned
+        static inline std::vector<std::unique_ptr<std::atomic<int64_t>>> m_queued_jobs; ///<number of jobs in the global, inject and deadline queues of each worker group
+        static inline std::vector<std::unique_ptr<ParkingLot>>  m_parking;      ///<idle threads of each worker group sleep here
+        static inline std::vector<std::vector<uint32_t>>        m_group_threads;///<thread indices of each worker group
+        static inline std::vector<uint32_t>                     m_thread_groups;///<worker group of each thread
+        static inline std::vector<uint32_t>                     m_group_pos;    ///<position of each thread in its worker group
+        static inline std::vector<std::unique_ptr<std::atomic<uint32_t>>> m_active_threads; ///<number of active threads of each worker group, the first ones are active
+        static inline std::unordered_map<int32_t, uint32_t>     m_type_groups;  ///<map job types to worker groups
+        static inline std::vector<std::unique_ptr<thread_counters>>                             m_counters; ///<scheduling counters of each thread
+        static inline std::atomic<bool>                     m_steal_half = false;   ///< if true then thieves take half of the victim's jobs
+        static inline std::atomic<bool>                     m_deadline_scheduling = false;  ///< if true then jobs with deadlines are run earliest deadline first
+        static inline std::atomic<uint32_t>                 m_max_inline_depth = 0; ///<continuations are run right away up to this nesting depth, 0 means never
+        static inline thread_local uint32_t                 m_inline_depth = 0;     ///<number of nested continuations this thread runs right away
+        static inline thread_local Job_base*                m_yield_job = nullptr;  ///<job that called yield_if_needed() last
+        static inline thread_local uint32_t                 m_wait_depth = 0;       ///<number of nested waits of this worker
+        static inline thread_local uint32_t                 m_grow_count = 0;       ///<jobs run since the queue lengths were looked at last
+        static inline std::atomic<uint32_t>                 m_fair_burst = 32;      ///<at most N jobs in a row from the local queues or the next slot, 0 means no limit
+        static inline thread_local uint32_t                 m_local_streak = 0;     ///<number of jobs in a row from the local queues
+        static inline thread_local uint32_t                 m_next_streak = 0;      ///<number of jobs in a row from the next slot
+        static inline thread_local uint32_t                 m_global_streak = 0;    ///<number of jobs in a row from the own global queue
+        static inline std::atomic<bool>                     m_wait_statistics = false;  ///<if true then the time jobs wait in the queues is measured
+        static inline std::atomic<int64_t>                  m_wait_since = 0;       ///<when wait statistics were enabled, older time stamps are ignored
+        static inline thread_local high_resolution_clock::time_point m_yield_time;  ///<when that job started running or yielded last
+        static inline std::atomic<uint32_t>                 m_spin_count = IdlePolicy{}.m_spin_count;   ///<idle policy, searches before parking
+        static inline std::atomic<uint32_t>                 m_max_backoff = IdlePolicy{}.m_max_backoff; ///<idle policy, max pause instructions between searches
+        static inline std::atomic<int64_t>                  m_park_timeout = IdlePolicy{}.m_park_timeout.count(); ///<idle policy, max park time in us
+        static inline std::atomic<bool>                     m_adaptive_idle = IdlePolicy{}.m_adaptive;  ///<idle policy, tune spinning from job inter-arrival times
+        static inline std::atomic<bool>                     m_elastic_auto = ElasticPolicy{}.m_auto;    ///<elastic policy, activate and deactivate threads automatically
+        static inline std::atomic<uint32_t>                 m_elastic_min = ElasticPolicy{}.m_min_threads;  ///<elastic policy, minimum number of active threads
+        static inline std::atomic<uint32_t>                 m_elastic_max = ElasticPolicy{}.m_max_threads;  ///<elastic policy, maximum number of active threads, 0 means all
+        static inline std::atomic<uint32_t>                 m_grow_depth = ElasticPolicy{}.m_grow_depth;    ///<elastic policy, queued jobs that activate another thread
+        static inline std::atomic<int64_t>                  m_shrink_idle = ElasticPolicy{}.m_shrink_idle.count(); ///<elastic policy, idle time in us that deactivates a thread
+        static inline std::mutex                            m_affinity_mutex;       ///<protects the affinity policy
+        static inline AffinityPolicy                        m_affinity;             ///<current affinity policy
+        static inline std::vector<int>                      m_affinity_cpus;        ///<logical CPU of each thread, -1 if not pinned
+        static inline std::atomic<uint32_t>                 m_affinity_epoch = 0;   ///<incremented when the affinity policy changes
+        static inline thread_local uint32_t                 m_applied_epoch = 0;    ///<affinity policy that this thread has applied
+        static inline std::vector<cpu_info>                 m_topology;             ///<topology of the logical CPUs, read when the affinity policy is set
+        static inline thread_local std::array<std::vector<uint32_t>, cpu_info::c_remote + 1> m_victims; ///<other threads of the own group by distance
+        static inline thread_local int                      m_node = -1;            ///<NUMA node of this thread if it is pinned, else -1
+        static inline thread_local n_pmr::memory_resource*  m_node_mr = nullptr;    ///<pool of the NUMA node of this thread, or nullptr
+        static inline std::map<int, std::unique_ptr<n_pmr::synchronized_pool_resource>> m_node_resources;  ///<one pool for Jobs per NUMA node, protected by m_affinity_mutex
+        static inline thread_local uint32_t                 m_random = 0;           ///<state of the xorshift random generator of this thread
+        static inline thread_local std::vector<uint8_t>     m_steal_score;          ///<recent steal success of this thread per victim
+        static inline TagRegistry                           m_tags;                 ///<queues of the tags
+        static inline thread_local JobQueue<Job,false>      m_recycle;        ///<save old jobs for recycling
+        static inline thread_local JobQueue<Job,false>      m_delete;         ///<save old jobs for deleting
+        static inline thread_local uint32_t                 m_batch_depth = 0;  ///<if >0 then jobs are collected in chains instead of being scheduled
+        static inline thread_local std::vector<std::array<job_chain, c_num_priorities>> m_batch_global;   ///<batched jobs for the global or inject queues of each group
+        static inline thread_local std::vector<std::array<job_chain, c_num_priorities>> m_batch_deadline; ///<batched jobs for the deadline queues of each group
+        static inline thread_local std::vector<std::array<job_chain, c_num_priorities>> m_batch_local;  ///<batched jobs for the local queues
+        static inline n_pmr::vector<n_pmr::vector<JobLog>>	m_logs;				    ///< log the start and stop times of jobs
+        static inline bool                                  m_logging = false;      ///< if true then jobs will be logged
+        static inline std::map<int32_t, std::string>        m_types;                ///<map types to a string for logging
+        static inline std::chrono::time_point<std::chrono::high_resolution_clock> m_start_time = std::chrono::high_resolution_clock::now();	//time when program started
+
+        /**
+        * \brief Allocate a job so that it can be scheduled.
+        *
+        * If there is a job in the recycle queue we use this. Else a new
+        * new Job struct is allocated from the pool of the thread's NUMA node, or from the memory resource m_mr
+        * if the thread is not pinned.
+        *
+        * \returns a pointer to the job.
+        */
+        Job* allocate_job() {
+            Job* job = m_recycle.pop();                                 //try recycle queue
+            if (job == nullptr ) {                                      //none found
+                n_pmr::memory_resource* mr = m_node_mr != nullptr ? m_node_mr : m_mr;
+                n_pmr::polymorphic_allocator<Job> allocator(mr);        //use this allocator
+                job = allocator.allocate(1);                            //allocate the object
+                if (job == nullptr) {
+                    std::cout << "No job available\n";
+                    std::terminate();
+                }
+                new (job) Job(mr);                   //call constructor
+                job->m_node = m_node;
+            }
+            else {                                  //job found
+                job->reset();                       //reset it
+            }
+            return job;
+        }
+
+        /**
+        * \brief Allocate a job so that it can be scheduled.
+        * \param[in] f Function that should be executed by the job.
+        * \returns a pointer to the Job.
+        */
+        template <typename F>
+        requires FUNCTOR<F>
+        Job* allocate_job(F&& f) noexcept {
+            Job* job = allocate_job();
+            if constexpr (std::is_same_v<std::decay_t<F>, Function>) {
+                job->m_function     = f.get_function();
+                job->m_pfvoid       = nullptr;
+                job->m_thread_index = f.m_thread_index;
+                job->m_type         = f.m_type;
+                job->m_id           = f.m_id;
+                job->m_priority     = f.m_priority;
+                job->m_deadline     = f.m_deadline;
+            }
+            else {
+                if constexpr (std::is_pointer_v<std::remove_reference_t<decltype(f)>>) {
+                    job->m_pfvoid = f;
+                }
+                else {
+                    job->m_function = f; //std::function<void(void)> or a lambda
+                    job->m_pfvoid = nullptr;
+                }
+            }
+
+            if (!job->m_function && !job->m_pfvoid) {
+                std::cout << "Empty function\n";
+                std::terminate();
+            }
+            return job;
+        }
+
+        /**
+        * \brief Create the deadline queues of one thread, each with room for c_queue_capacity jobs from m_mr.
+        * \returns one deadline queue for each priority.
+        */
+        template<std::size_t... P>
+        std::array<DeadlineQueue<Job_base>, c_num_priorities> deadline_queues(std::index_sequence<P...>) noexcept {
+            return { ((void)P, DeadlineQueue<Job_base>{ m_mr, c_queue_capacity })... };
+        }
+
+        /**
+        * \brief Create the worker groups and start their threads, only the first call does something.
+        * \param[in] groups The worker groups.
+        * \param[in] start_idx Number of first thread, if 1 then the main thread should enter as thread 0.
+        * \param[in] mr The memory resource to use for allocating Jobs.
+        */
+        void init(const std::vector<WorkerGroup>& groups, thread_index_t start_idx, n_pmr::memory_resource* mr) noexcept {
+            auto cnt = m_init_counter.fetch_add(1);
+            if (cnt > 0) return;
+
+            m_mr = mr;
+            m_start_idx = start_idx;
+            m_terminate = false;
+            m_terminated = false;
+        #if defined(__linux__)
+            process_cpus();                 //save the affinity mask before any thread is pinned
+        #endif
+
+            uint32_t num = 0;
+            for (uint32_t g = 0; g < std::max((uint32_t)groups.size(), 1u); ++g) {
+                WorkerGroup group = g < groups.size() ? groups[g] : WorkerGroup{};
+                uint32_t count = group.m_count.value > 0 ? group.m_count.value : std::thread::hardware_concurrency();
+                m_group_threads.push_back({});
+                for (uint32_t i = 0; i < std::max(count, 1u); ++i) {
+                    m_group_threads[g].push_back(num++);
+                    m_thread_groups.push_back(g);
+                    m_group_pos.push_back(i);
+                }
+                m_active_threads.emplace_back(std::make_unique<std::atomic<uint32_t>>((uint32_t)m_group_threads[g].size()));
+                m_high_jobs.emplace_back(std::make_unique<std::atomic<int64_t>>(0));
+                m_queued_jobs.emplace_back(std::make_unique<std::atomic<int64_t>>(0));
+                if (group.m_type.value >= 0) {
+                    m_type_groups[group.m_type.value] = g;
+                    if (!group.m_name.empty()) m_types[group.m_type.value] = group.m_name;
+                }
+                m_parking.emplace_back(std::make_unique<ParkingLot>());
+            }
+            m_thread_count = num;
+
+            for (uint32_t i = 0; i < m_thread_count; i++) {
+                m_global_queues.push_back({});      //global job queues
+                m_inject_queues.push_back({});      //queues for jobs from outside the pool
+                m_local_queues.push_back({});       //local job queues
+                m_deadline_queues.push_back(deadline_queues(std::make_index_sequence<c_num_priorities>{}));    //deadline job queues
+                m_next_slots.emplace_back(std::make_unique<NextSlot>());
+                m_counters.emplace_back(std::make_unique<thread_counters>());
+            }
+
+            for (auto& parking : m_parking) parking->resize(m_thread_count);
+            m_starting = m_thread_count - std::min((uint32_t)std::max(start_idx.value, 0), m_thread_count.load());
+            m_workers = m_starting.load();          //threads below start_idx are counted when they enter
+
+            for (uint32_t i = start_idx.value; i < m_thread_count; i++) {
+                //std::cout << "Starting thread " << i << std::endl;
+                m_threads.push_back(std::thread(&JobSystem::thread_task, this, thread_index_t(i) ));	//spawn the pool threads
+                m_threads.back().detach();
+            }
+
+            m_logs.resize(m_thread_count, n_pmr::vector<JobLog>{mr});    //make room for the log files
+        }
+
+        /**
+        * \brief Get the worker group that runs a job.
+        * \param[in] job The job.
+        * \returns the index of the worker group.
+        */
+        uint32_t group_of(Job_base* job) noexcept {
+            if (m_group_threads.size() == 1) return 0;
+            auto it = m_type_groups.find(job->m_type.value);
+            return it == m_type_groups.end() ? 0 : it->second;
+        }
+
+        /**
+        * \brief Test whether the calling thread is a worker of a group.
+        * \param[in] group The index of the worker group.
+        * \returns true if the calling thread belongs to the group.
+        */
+        bool in_group(uint32_t group) noexcept {
+            return m_thread_index.value >= 0 && m_thread_index.value < (int)m_thread_count && m_thread_groups[m_thread_index.value] == group;
+        }
+
+        /**
+        * \brief Xorshift random generator, each thread has its own state, so no locks are needed.
+        * \returns a random number.
+        */
+        uint32_t random() noexcept {
+            uint32_t x = m_random;
+            if (x == 0) x = (uint32_t)std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;  //seed on first use
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            return m_random = x;
+        }
+
+        /**
+        * \brief Choose an active thread of a worker group round robin, e.g. for putting jobs into its inject queue.
+        * \param[in] group The index of the worker group.
+        * \returns the index of the thread.
+        */
+        thread_index_t next_in_group(uint32_t group) noexcept {
+            thread_local static uint32_t counter = random();
+            auto& threads = m_group_threads[group];
+            uint32_t active = std::clamp(m_active_threads[group]->load(std::memory_order::relaxed), 1u, (uint32_t)threads.size());
+            return thread_index_t((int)threads[++counter % active]);
+        }
+
+        /**
+        * \brief Test whether a thread is active, i.e. it runs and steals jobs of its group and can be stolen from.
+        * \param[in] index Index of the thread.
+        * \returns true if the thread is one of the active threads of its group.
+        */
+        bool is_active(uint32_t index) noexcept {
+            return m_group_pos[index] < m_active_threads[m_thread_groups[index]]->load(std::memory_order::relaxed);
+        }
+
+
+    public:
+
+        /**
+        * \brief JobSystem class constructor.
+        * \param[in] threadCount Number of threads in the system.
+        * \param[in] start_idx Number of first thread, if 1 then the main thread should enter as thread 0.
+        * \param[in] mr The memory resource to use for allocating Jobs.
+        */
+        JobSystem(thread_count_t threadCount = thread_count_t(0), thread_index_t start_idx = thread_index_t(0)
+            , n_pmr::memory_resource* mr = n_pmr::new_delete_resource()) noexcept {
+
+            if (m_init_counter > 0) [[likely]] return;
+            init({ WorkerGroup{ thread_type_t{}, threadCount } }, start_idx, mr);
+        };
+
+        /**
+        * \brief JobSystem class constructor, the threads are partitioned into worker groups.
+        * \param[in] groups The worker groups, the first group runs all jobs whose type does not belong to another group.
+        * \param[in] start_idx Number of first thread, if 1 then the main thread should enter as thread 0.
+        * \param[in] mr The memory resource to use for allocating Jobs.
+        */
+        JobSystem(const std::vector<WorkerGroup>& groups, thread_index_t start_idx = thread_index_t(0)
+            , n_pmr::memory_resource* mr = n_pmr::new_delete_resource()) noexcept {
+
+            if (m_init_counter > 0) [[likely]] return;
+            init(groups, start_idx, mr);
+        };
+
+
+        /**
+        * \brief Test whether the job system has been started yet.
+        * \returns true if the instance exists, else false.
+        */
+        static bool is_instance_created() noexcept {
+            return m_current_job != nullptr;
+        };
+
+        JobSystem(const JobSystem&) = delete;				// non-copyable,
+        JobSystem& operator=(const JobSystem&) = delete;
+        JobSystem(JobSystem&&) = default;					// but movable
+        JobSystem& operator=(JobSystem&&) = default;
+        ~JobSystem() = default;
+
+        void on_finished(Job* job) noexcept;            //called when the job finishes, i.e. all children have finished
+
+        /**
+        * \brief Child tells its parent that it has finished.
+        *
+        * A child that finished calls this function for its parent, thus decreasing
+        * the number of left children by one. If the last one finishes (including the
+        * parent itself) then the parent also finishes (and may call its own parent).
+        * Note that a Job is also its own child, so it must have returned from
+        * its function before on_finished() is called. Note that a Job is also its own
+        * child so that the Job can only finish after its function has returned.
+        */
+        inline bool child_finished(Job_base* job) noexcept {
+            uint32_t num = job->m_children.fetch_sub(1);        //one less child
+            if (num == 1) {                                     //was it the last child?
+
+                if (job->is_function()) {            //Jobs call always on_finished()
+                    on_finished((Job*)job);     //if yes then finish this job
+                }
+                else {
+                    schedule_next(job);  //a coro just gets scheduled again so it can go on
+                }
+                return true;
+            }
+            return false;
+        }
+
+        /**
+        * \brief Wake up parked threads because new jobs are available.
+        * \param[in] num Number of new jobs, at most this many threads are woken up.
+        * \param[in] index If valid then this thread is woken up first, e.g. the owner of the queue that got the jobs.
+        * Only threads of its worker group are woken up. If empty then threads of the caller's group are woken up.
+        */
+        void wake_threads(uint32_t num, thread_index_t index = thread_index_t{}) noexcept {
+            std::atomic_thread_fence(std::memory_order::seq_cst);   //pairs with the fence in ParkingLot::park()
+            bool valid = index.value >= 0 && index.value < (int)m_thread_count;
+            if (!valid && (m_thread_index.value < 0 || m_thread_index.value >= (int)m_thread_count)) return;
+            auto& parking = *m_parking[m_thread_groups[valid ? index.value : m_thread_index.value]];
+            if (parking.num_idle() == 0) return;                    //nobody sleeps
+            if (valid && parking.unpark_thread(index.value)) {
+                if (--num == 0) return;
+            }
+            parking.unpark(num);
+        }
+
+        /**
+        * \brief Wake up a thread that got a job in its local queue, if it is parked.
+        * \param[in] index Index of the thread.
+        */
+        void wake_thread(thread_index_t index) noexcept {
+            std::atomic_thread_fence(std::memory_order::seq_cst);   //pairs with the fence in ParkingLot::park()
+            m_parking[m_thread_groups[index.value]]->unpark_thread(index.value);
+        }
+
+        /**
+        * \brief Test whether a thread could find a job, used before it parks.
+        *
+        * An inactive thread only looks at its own queues, an active thread also at the queues of the other active threads of its group.
+        * The shared queues are looked at only if the group has queued jobs at all, see count_queued(), so an idle group costs
+        * the thread only a look at its own next slot and local queues.
+        *
+        * \param[in] index Index of the thread.
+        * \returns true if the thread should not sleep.
+        */
+        bool has_work(uint32_t index) noexcept {
+            if (terminating() || m_next_slots[index]->m_job.load(std::memory_order::relaxed) != nullptr) return true;
+            for (uint32_t p = 0; p < c_num_priorities; ++p) {
+                if (!m_local_queues[index][p].empty()) return true;
+            }
+            if (m_queued_jobs[m_thread_groups[index]]->load(std::memory_order::relaxed) <= 0) return false;
+            bool active = is_active(index);
+            for (uint32_t p = 0; p < c_num_priorities; ++p) {
+                for (uint32_t i : m_group_threads[m_thread_groups[index]]) {    //only jobs of the own group
+                    if (i != index && (!active || !is_active(i))) continue;
+                    if (m_global_queues[i][p].size() > 0 || m_inject_queues[i][p].size() > 0 || m_deadline_queues[i][p].size() > 0) return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+
+        /**
+        * \brief Count jobs that go into or come out of the global, inject and deadline queues of a worker group.
+        *
+        * Jobs are counted before they are pushed and after they have been popped, so the count is never too low, and
+        * has_work() can rely on it. Jobs that a thief moves from one queue of the group into another are not counted again.
+        *
+        * \param[in] group The worker group.
+        * \param[in] n Number of jobs, negative if they are taken out.
+        */
+        void count_queued(uint32_t group, int64_t n) noexcept {
+            m_queued_jobs[group]->fetch_add(n, std::memory_order::relaxed);
+        }
+
+        /**
+        * \brief Count a high priority job that goes into or comes out of the shared queues or a next slot.
+        *
+        * Pinned jobs are not counted, they are found in the local queue of their thread.
+        *
+        * \param[in] job The job.
+        * \param[in] n 1 if the job is queued, -1 if it is taken out.
+        */
+        void count_high(Job_base* job, int64_t n) noexcept {
+            if (job->m_priority.value != priority_high) return;
+            if (job->m_thread_index.value >= 0 && job->m_thread_index.value < (int)m_thread_count) return;
+            m_high_jobs[group_of(job)]->fetch_add(n, std::memory_order::relaxed);
+        }
+
+        /**
+        * \brief Test whether there are high priority jobs that the calling worker could run,
+        * i.e. jobs pinned to it or queued jobs of its worker group.
+        * \returns true if the worker should run high priority jobs first.
+        */
+        bool high_jobs_waiting() noexcept {
+            uint32_t index = m_thread_index.value;
+            return !m_local_queues[index][priority_high].empty() || m_high_jobs[m_thread_groups[index]]->load(std::memory_order::relaxed) > 0;
+        }
+
+        /**
+        * \brief Steal jobs from another thread.
+        *
+        * A thief takes the job with the earliest deadline from the victim's deadline queue, or
+        * one job from the victim's global queue, or if this is empty, from its inject queue.
+        * In steal half mode the thief additionally moves about half of the victim's remaining
+        * global or inject jobs into its own global queue.
+        *
+        * \param[in] victim Index of the thread to steal from.
+        * \param[in] prio Priority class of the queues to steal from.
+        * \returns a job to run, or nullptr.
+        */
+        Job_base* steal(uint32_t victim, uint32_t prio) noexcept {
+            auto& counters = *m_counters[m_thread_index.value];
+            thread_counters::add(counters.m_steal_attempts);
+
+            auto& deadline = m_deadline_queues[victim][prio];
+            Job_base* job = deadline.pop();
+            if (job != nullptr) {
+                thread_counters::add(counters.m_steals);
+                thread_counters::add(counters.m_stolen_jobs);
+                if (deadline.size() > 0) wake_threads(1);
+                return job;
+            }
+
+            auto& global = m_global_queues[victim][prio];
+            job = global.steal();
+            if (job != nullptr) {
+                uint32_t num = 1;
+                if (m_steal_half) {
+                    job_chain chain;
+                    uint32_t half = std::min(global.size() / 2, c_max_steal);
+                    while (chain.m_size < half) {       //each job is claimed with one CAS on the victim's top
+                        Job_base* next = global.steal();
+                        if (next == nullptr) break;
+                        chain.push(next);
+                    }
+                    if (chain.m_size > 0) {             //make them available with one push
+                        m_global_queues[m_thread_index.value][prio].push(chain.m_first, chain.m_last, chain.m_size);
+                        num += chain.m_size;
+                    }
+                }
+                thread_counters::add(counters.m_steals);
+                thread_counters::add(counters.m_stolen_jobs, num);
+                if (global.size() > 0 || num > 1) wake_threads(1);  //there is more, so let another thread join in
+                return job;
+            }
+
+            Job_base* first;
+            Job_base* last;
+            uint32_t num = m_inject_queues[victim][prio].pop(m_steal_half ? c_max_steal : 1, first, last, true); //one lock operation
+            if (num == 0) return nullptr;
+            if (num > 1) {
+                m_global_queues[m_thread_index.value][prio].push((Job_base*)first->m_next.load(std::memory_order::relaxed), last, num - 1);
+            }
+            thread_counters::add(counters.m_steals);
+            thread_counters::add(counters.m_stolen_jobs, num);
+            if (num > 1 || m_inject_queues[victim][prio].size() > 0) wake_threads(1);
+            return first;
+        }
+
+        /**
+        * \brief Steal from a victim and remember whether it had work.
+        *
+        * A success raises the score of the victim, a failure halves it, so victims that
+        * recently had work are tried first. Inactive threads are not stolen from, they hand off their jobs themselves.
+        *
+        * \param[in] victim Index of the thread to steal from.
+        * \param[in] prio Priority class of the queues to steal from.
+        * \returns a job to run, or nullptr.
+        */
+        Job_base* try_steal(uint32_t victim, uint32_t prio) noexcept {
+            if (!is_active(victim)) return nullptr;
+            Job_base* job = steal(victim, prio);
+            uint8_t& score = m_steal_score[victim];
+            score = job != nullptr ? (uint8_t)std::min(score + 4, 255) : (uint8_t)(score / 2);
+            return job;
+        }
+
+        /**
+        * \brief Look for a job of a priority class, first in the own queues, then in the queues of the other threads of the worker group.
+        *
+        * The other threads are tried nearest first, see apply_affinity(). Within a distance level the
+        * victim with the most recent successful steals is tried first, then the others from a random start.
+        *
+        * High priority jobs are counted, so threads only steal them if there are some. Inactive threads do not steal.
+        * After m_fair_burst jobs in a row from the local queue the other queues are tried first once, so a stream
+        * of pinned jobs cannot starve the other jobs. Likewise, after m_fair_burst jobs in a row from the own global
+        * queue the inject queue is tried first once, so jobs from outside the pool are not starved.
+        *
+        * \param[in] prio The priority class.
+        * \returns a job to run, or nullptr.
+        */
+        Job_base* find_job(uint32_t prio) noexcept {
+            if ((int)prio == priority_high && !high_jobs_waiting()) return nullptr;
+
+            uint32_t burst = m_fair_burst.load(std::memory_order::relaxed);
+            bool fair = burst > 0 && m_local_streak >= burst;                       //the other queues have a turn
+            Job_base* job = fair ? nullptr : m_local_queues[m_thread_index.value][prio].pop();  //try get a job from the local queue
+            bool local = job != nullptr;
+            if (job == nullptr) {
+                job = m_deadline_queues[m_thread_index.value][prio].pop();          //try get the job with the earliest deadline
+            }
+            bool inject = burst > 0 && m_global_streak >= burst;                    //jobs from outside have a turn
+            if (job == nullptr && inject) {
+                job = m_inject_queues[m_thread_index.value][prio].pop();
+            }
+            if (job == nullptr) {
+                job = m_global_queues[m_thread_index.value][prio].pop();            //try get a job from the global queue
+                m_global_streak = job != nullptr ? m_global_streak + 1 : 0;
+            }
+            else m_global_streak = 0;
+            if (job == nullptr) {
+                job = m_inject_queues[m_thread_index.value][prio].pop();            //try get a job scheduled from outside
+            }
+            bool active = job != nullptr || is_active(m_thread_index.value);
+            for (uint32_t d = 0; job == nullptr && active && d < m_victims.size(); ++d) {    //try steal job from another thread of the group
+                auto& level = m_victims[d];                                         //nearest threads first
+                if (level.empty()) continue;
+                uint32_t best = 0;                                                  //victim with the most recent successes
+                for (uint32_t i = 1; i < level.size(); ++i) {
+                    if (m_steal_score[level[i]] > m_steal_score[level[best]]) best = i;
+                }
+                if (m_steal_score[level[best]] > 0) job = try_steal(level[best], prio);
+                uint32_t start = random() % level.size();                          //then all others in random order
+                for (uint32_t i = 0; job == nullptr && i < level.size(); ++i) {
+                    uint32_t v = (start + i) % level.size();
+                    if (v != best || m_steal_score[level[best]] == 0) job = try_steal(level[v], prio);
+                }
+                if (job != nullptr && d == cpu_info::c_remote) {
+                    thread_counters::add(m_counters[m_thread_index.value]->m_remote_steals);
+                }
+            }
+            if (job == nullptr && fair) {
+                job = m_local_queues[m_thread_index.value][prio].pop();             //there is nothing else
+                local = job != nullptr;
+            }
+            if (job != nullptr) {
+                m_local_streak = local ? m_local_streak + 1 : 0;
+                count_wait(job, local);
+            }
+            if (job != nullptr) {
+                count_high(job, -1);
+                if (!local) count_queued(m_thread_groups[m_thread_index.value], -1);
+            }
+            return job;
+        }
+
+        /**
+        * \brief Wait statistics: time stamp a job that goes into a queue or a next slot.
+        * \param[in] job The job.
+        */
+        void stamp(Job_base* job) noexcept {
+            if (m_wait_statistics.load(std::memory_order::relaxed)) job->m_queued = high_resolution_clock::now();
+        }
 
-                if (m_current_job != nullptr) {
-                    std::chrono::high_resolution_clock::time_point t1, t2;	///< execution start and end
-                    thread_type_t type;
-                    thread_id_t id;
+        /**
+        * \brief Wait statistics: count the time a job has waited in the queues.
+        * \param[in] job The job that has been taken out of a queue.
+        * \param[in] local True if it came from a local queue.
+        */
+        void count_wait(Job_base* job, bool local) noexcept {
+            if (!m_wait_statistics.load(std::memory_order::relaxed)) return;
+            if (job->m_queued.time_since_epoch().count() < m_wait_since.load(std::memory_order::relaxed)) return;   //queued before
+            uint64_t wait = std::max((int64_t)0, (int64_t)duration_cast<nanoseconds>(high_resolution_clock::now() - job->m_queued).count());
+            auto& counters = *m_counters[m_thread_index.value];
+            thread_counters::add(local ? counters.m_local_jobs : counters.m_global_jobs);
+            thread_counters::add(local ? counters.m_local_wait : counters.m_global_wait, wait);
+            thread_counters::max(local ? counters.m_local_max_wait : counters.m_global_max_wait, wait);
+        }
 
-                    if constexpr (c_enable_logging) {
-                        if (is_logging()) {
-                            t1 = std::chrono::high_resolution_clock::now();	//time of starting
-                        }
-                        type = m_current_job->m_type;
-                        id = m_current_job->m_id;
-                    }
-                    auto is_function = m_current_job->is_function();      //save certain info since a coro might be destroyed
+        /**
+        * \brief Take the job out of the own next slot.
+        *
+        * If there are high priority jobs that this thread could run and the job is not one of them, then the job goes into
+        * the global queue instead, and a parked thread is woken up to steal it.
+        *
+        * \returns a job to run, or nullptr.
+        */
+        Job_base* take_next() noexcept {
+            Job_base* job = m_next_slots[m_thread_index.value]->take();
+            if (job == nullptr) return nullptr;
+            if (job->m_priority.value == priority_high) {
+                count_high(job, -1);
+            }
+            else if (high_jobs_waiting()) {
+                count_queued(m_thread_groups[m_thread_index.value], 1);
+                m_global_queues[m_thread_index.value][job->m_priority.value].push(job);
+                wake_threads(1);                    //this thread runs the high priority jobs first, so another one may take it
+                return nullptr;
+            }
+            count_wait(job, false);
+            return job;
+        }
 
-                    (*m_current_job)();   //if any job found execute it - a coro might be destroyed here!
+        /**
+        * \brief Steal a job from the next slot of another thread of the group, nearest threads first.
+        *
+        * This is the last resort of a thief, and only jobs that have waited for longer than the
+        * grace period are taken.
+        *
+        * \returns a job to run, or nullptr.
+        */
+        Job_base* steal_next() noexcept {
+            if (!is_active(m_thread_index.value)) return nullptr;
+            for (auto& level : m_victims) {
+                for (uint32_t victim : level) {
+                    if (!is_active(victim)) continue;
+                    Job_base* job = m_next_slots[victim]->steal(c_next_grace);
+                    if (job == nullptr) continue;
+                    count_high(job, -1);
+                    auto& counters = *m_counters[m_thread_index.value];
+                    thread_counters::add(counters.m_steals);
+                    thread_counters::add(counters.m_stolen_jobs);
+                    count_wait(job, false);
+                    return job;
+                }
+            }
+            return nullptr;
+        }
 
-                    if constexpr (c_enable_logging) {
-                        if (is_logging()) {
-                            t2 = std::chrono::high_resolution_clock::now();	//time of finishing
-                            log_data(t1, t2, m_thread_index, false, type, id);
-                        }
-                    }
+        /**
+        * \brief An inactive thread gives a job of its group to an active thread, through the inject or deadline queue of the thread.
+        * \param[in] job The job, it was taken out of the queues of the calling thread.
+        */
+        void hand_off(Job_base* job) noexcept {
+            uint32_t prio = job->m_priority.value;
+            count_high(job, 1);                         //it was counted down when taken
+            count_queued(m_thread_groups[m_thread_index.value], 1);
+            thread_index_t index = next_in_group(m_thread_groups[m_thread_index.value]);
+            bool edf = m_deadline_scheduling && job->m_deadline != no_deadline;
+            if (edf ? m_deadline_queues[index][prio].push(job) : m_inject_queues[index][prio].push(job)) {
+                wake_threads(1, index);
+            }
+        }
 
-                    if (is_function) {
-                        child_finished((Job*)m_current_job);  //a job always finishes itself, a coro will deal with this itself
-                    }
-                    noop_counter = 0;
+        /**
+        * \brief Automatic elastic mode, activate one more thread of the own group if the own queues are long.
+        *
+        * Jobs from outside the pool and handed off jobs count as well. Since the queue lengths are shared with
+        * thieves, they are looked at only every c_grow_interval jobs.
+        */
+        void grow_if_busy() noexcept {
+            if (++m_grow_count < c_grow_interval) return;
+            m_grow_count = 0;
+            uint32_t queued = 0;
+            for (uint32_t p = 0; p < c_num_priorities; ++p) {
+                queued += m_global_queues[m_thread_index.value][p].size() + m_inject_queues[m_thread_index.value][p].size()
+                    + m_deadline_queues[m_thread_index.value][p].size();
+            }
+            if (queued <= m_grow_depth.load(std::memory_order::relaxed)) return;
+            uint32_t group = m_thread_groups[m_thread_index.value];
+            auto& threads = m_group_threads[group];
+            uint32_t max = m_elastic_max.load(std::memory_order::relaxed);
+            max = max == 0 ? (uint32_t)threads.size() : std::min(max, (uint32_t)threads.size());
+            uint32_t active = m_active_threads[group]->load(std::memory_order::relaxed);
+            if (active < max && m_active_threads[group]->compare_exchange_strong(active, active + 1)) {
+                m_parking[group]->unpark_thread(threads[active]);   //the new thread starts stealing right away
+            }
+        }
+
+        /**
+        * \brief Automatic elastic mode, the last active thread of its group deactivates itself if it has been idle for too long.
+        * \param[in] idle Time since the thread has run its last job.
+        */
+        void shrink_if_idle(std::chrono::nanoseconds idle) noexcept {
+            if (idle < std::chrono::microseconds(m_shrink_idle.load(std::memory_order::relaxed))) return;
+            uint32_t group = m_thread_groups[m_thread_index.value];
+            uint32_t pos = m_group_pos[m_thread_index.value];
+            uint32_t active = pos + 1;
+            if (pos >= std::max(m_elastic_min.load(std::memory_order::relaxed), 1u)) {
+                m_active_threads[group]->compare_exchange_strong(active, pos);
+            }
+        }
+
+        /**
+        * \brief Pin the calling worker thread as given by the current affinity policy.
+        *
+        * Also sorts the other threads of the worker group by their distance, so the thread steals
+        * from SMT siblings first, then from the same last level cache, the same NUMA node, and then
+        * from other nodes. If a thread is not pinned, then its distance is unknown and it is treated like
+        * a thread on the same node. A pinned thread allocates its Jobs from the pool of its node.
+        *
+        * \param[in] pin If false then only the victims are sorted.
+        * \returns the epoch of the applied policy.
+        */
+        uint32_t apply_affinity(bool pin = true) noexcept {
+            std::lock_guard<std::mutex> lock(m_affinity_mutex);
+            auto cpu_of = [&](uint32_t i) { return i < m_affinity_cpus.size() ? m_affinity_cpus[i] : -1; };
+            int cpu = cpu_of(m_thread_index.value);
+            if (pin) set_thread_affinity(cpu);
+            if (cpu >= (int)m_topology.size()) cpu = -1;
+            m_node = cpu >= 0 ? m_topology[cpu].m_node : -1;
+            m_node_mr = nullptr;
+            if (m_node >= 0) {                  //memory of the pool is first touched by threads of this node
+                auto& pool = m_node_resources[m_node];
+                if (!pool) pool = std::make_unique<n_pmr::synchronized_pool_resource>(n_pmr::pool_options{ .max_blocks_per_chunk = c_queue_capacity, .largest_required_pool_block = sizeof(Job) }, m_mr);
+                m_node_mr = pool.get();
+            }
+            for (auto& level : m_victims) level.clear();
+            for (uint32_t i : m_group_threads[m_thread_groups[m_thread_index.value]]) {
+                if (i == (uint32_t)m_thread_index.value) continue;
+                int other = cpu_of(i);
+                auto distance = cpu >= 0 && other >= 0 && other < (int)m_topology.size() ? m_topology[cpu].distance(m_topology[other]) : cpu_info::c_node;
+                m_victims[distance].push_back(i);
+            }
+            return m_affinity_epoch.load();
+        }
+
+        /**
+        * \brief A thread becomes a worker of the pool.
+        *
+        * Threads started by the job system wait until all of them are running. A thread below
+        * start_idx, e.g. the main thread, enters whenever it likes, and from then on termination waits for it.
+        *
+        * \param[in] threadIndex Number of this thread.
+        */
+        void thread_start(thread_index_t threadIndex) noexcept {
+            m_thread_index = threadIndex;	                                //Remember your own thread index number
+            if (threadIndex.value >= m_start_idx.value) {
+                m_starting--;			                                    //count down
+                while (m_starting.load() > 0) {}	                        //Continue only if all threads are running
+            }
+            else {
+                m_workers++;                                                //the pool waits for this thread to exit
+            }
+            m_steal_score.assign(m_thread_count, 0);                        //no steal successes yet
+            apply_affinity(false);                                          //sort the victims by distance
+        }
+
+        /**
+        * \brief Run the current job of this thread. A Function also finishes itself, a coro deals with this itself.
+        */
+        void run_current_job() noexcept {
+            std::chrono::high_resolution_clock::time_point t1, t2;	///< execution start and end
+            thread_type_t type;
+            thread_id_t id;
+
+            if constexpr (c_enable_logging) {
+                if (is_logging()) {
+                    t1 = std::chrono::high_resolution_clock::now();	//time of starting
                 }
-                else if (++noop_counter > NOOP) [[unlikely]] {   //if none found too longs let thread sleep
-                    m_delete.clear();       //delete jobs to reclaim memory                  
-                    m_cv[0]->wait_for(lk, std::chrono::microseconds(100));
-                    //m_cv[m_thread_index.value]->wait_for(lk, std::chrono::microseconds(100));
-                    noop_counter = noop_counter / 2;
+                type = m_current_job->m_type;
+                id = m_current_job->m_id;
+            }
+            auto is_function = m_current_job->is_function();      //save certain info since a coro might be destroyed
+            Job_base* yield_job = m_yield_job;                      //this job may run on top of another one, see yield_if_needed()
+            auto yield_time = m_yield_time;
+            m_yield_job = nullptr;                                  //a recycled Job at the same address starts over
+
+            (*m_current_job)();   //if any job found execute it - a coro might be destroyed here!
+
+            m_yield_job = yield_job;
+            m_yield_time = yield_time;
+
+            if constexpr (c_enable_logging) {
+                if (is_logging()) {
+                    t2 = std::chrono::high_resolution_clock::now();	//time of finishing
+                    log_data(t1, t2, m_thread_index, false, type, id);
                 }
-            };
+            }
+
+            if (is_function) {
+                child_finished((Job*)m_current_job);  //a job always finishes itself, a coro will deal with this itself
+            }
+        }
 
-           //std::cout << "Thread " << m_thread_index.value << " left " << m_thread_count.load() << "\n";
+        /**
+        * \brief Find the next job of this thread, without waiting.
+        *
+        * After m_fair_burst jobs in a row from the next slot the queues are tried first once.
+        * An inactive thread hands off all jobs that are not pinned to it, see set_active_threads().
+        *
+        * \returns true if a job was found, it is in m_current_job.
+        */
+        bool next_job() noexcept {
+            uint32_t burst = m_fair_burst.load(std::memory_order::relaxed);
+            bool fair = burst > 0 && m_next_streak >= burst;                //the queues have a turn
+            m_current_job = fair ? nullptr : take_next();                   //the job that became ready last is cache-hot
+            m_next_streak = m_current_job != nullptr ? m_next_streak + 1 : 0;
+            for (uint32_t p = 0; p < c_num_priorities && m_current_job == nullptr; ++p) {
+                m_current_job = find_job(p);                                //higher priority classes first
+            }
+            if (m_current_job == nullptr && fair) {
+                m_current_job = take_next();                                //there is nothing else
+            }
+            if (m_current_job == nullptr) {
+                m_current_job = steal_next();                               //a job that waits too long in another slot
+            }
+            while (m_current_job != nullptr && m_current_job->m_thread_index.value != m_thread_index.value
+                && !is_active(m_thread_index.value)) [[unlikely]] {
+                hand_off(m_current_job);                                    //an inactive thread only runs its pinned jobs
+                m_current_job = nullptr;
+                for (uint32_t p = 0; p < c_num_priorities && m_current_job == nullptr; ++p) {
+                    m_current_job = find_job(p);
+                }
+            }
+            return m_current_job != nullptr;
+        }
 
-           m_global_queues[m_thread_index.value].clear(); //clear your global queue
-           m_local_queues[m_thread_index.value].clear();  //clear your local queue
+        /**
+        * \brief A worker leaves the pool after the job system has been terminated. The last one sets m_terminated.
+        */
+        void thread_exit() noexcept {
+           //std::cout << "Thread " << m_thread_index.value << " left " << m_workers.load() << "\n";
+
+           for (uint32_t p = 0; p < c_num_priorities; ++p) {
+               m_global_queues[m_thread_index.value][p].clear(); //clear your global queues
+               m_inject_queues[m_thread_index.value][p].clear(); //clear your inject queues
+               m_local_queues[m_thread_index.value][p].clear();  //clear your local queues
+               m_deadline_queues[m_thread_index.value][p].clear(); //clear your deadline queues
+           }
+           if (Job_base* job = m_next_slots[m_thread_index.value]->take(); job != nullptr) {
+               job->get_deallocator().deallocate(job);         //clear your next slot
+           }
+           m_thread_index = thread_index_t{};               //no longer a worker
 
-           uint32_t num = m_thread_count.fetch_sub(1);  //last thread clears recycle and garbage queues
+           uint32_t num = m_workers.fetch_sub(1);       //last thread clears recycle and garbage queues
            m_recycle.clear();
            m_delete.clear();
 
@@ -603,19 +2420,160 @@ namespace vgjs {
                }
                //std::cout << "Last thread " << m_thread_index << " terminated\n";
                m_terminated = true;
+               m_terminated.notify_all();
            }
+        }
+
+        /**
+        * \brief Test whether the workers should leave the pool, i.e. the job system has been terminated and no worker waits.
+        * \returns true if the workers should leave the pool.
+        */
+        bool terminating() noexcept {
+            return m_terminate.load(std::memory_order::relaxed) && m_worker_waits.load(std::memory_order::relaxed) == 0;
+        }
+
+        /**
+        * \brief Test whether the calling thread may enter the pool as a worker, i.e. it was not started by the job system.
+        * \param[in] index The index the thread wants to have.
+        * \returns true if the index is below start_idx and the thread is not a worker yet.
+        */
+        bool can_enter(thread_index_t index) noexcept {
+            return index.value >= 0 && index.value < m_start_idx.value && m_thread_index.value < 0 && !m_terminate;
+        }
+
+    public:
+
+        /**
+        * \brief Every thread runs in this function, until the job system is terminated.
+        *
+        * A thread that already entered with poll() keeps its index.
+        *
+        * \param[in] threadIndex Number of this thread
+        */
+        void thread_task(thread_index_t threadIndex = thread_index_t(0) ) noexcept {
+            uint32_t idle_loops = 0;                                        //number of failed searches in this idle period
+            uint32_t spin_limit = 0;                                        //number of failed searches before parking
+            uint32_t backoff = 1;                                           //pause instructions after the next failed search
+            IdlePolicy policy;
+            high_resolution_clock::time_point idle_start;                   //adaptive mode: start of the idle period
+            int64_t avg_gap = 0;                                            //adaptive mode: average time between jobs in ns
+            int64_t avg_search = 0;                                         //adaptive mode: average time of one failed search in ns
+            bool parked = false;                                            //adaptive mode: parked in this idle period
+            high_resolution_clock::time_point last_job = high_resolution_clock::now(); //elastic mode: end of the last job
+            if (m_thread_index.value != threadIndex.value) thread_start(threadIndex);
+
+            while (!terminating()) {			                            //Run until the job system is terminated
+                if (m_affinity_epoch.load(std::memory_order::relaxed) != m_applied_epoch) [[unlikely]] {
+                    m_applied_epoch = apply_affinity();                     //the affinity policy has changed
+                }
+
+                if (next_job()) {
+                    if (m_elastic_auto.load(std::memory_order::relaxed)) grow_if_busy();
+                    run_current_job();
+                    if (m_elastic_auto.load(std::memory_order::relaxed)) last_job = high_resolution_clock::now();
+                    if (idle_loops > 0) {                       //first job after an idle period
+                        if (policy.m_adaptive) {
+                            int64_t gap = duration_cast<nanoseconds>(high_resolution_clock::now() - idle_start).count();
+                            avg_gap += (gap - avg_gap) / 8;
+                        }
+                        idle_loops = 0;
+                        backoff = 1;
+                    }
+                }
+                else if (idle_loops++ == 0) {                   //an idle period starts, search again right away
+                    policy = get_idle_policy();
+                    spin_limit = policy.m_spin_count;
+                    if (policy.m_adaptive) {
+                        idle_start = high_resolution_clock::now();
+                        parked = false;
+                        if (avg_search > 0) {                   //spin only if the next job should arrive in time
+                            int64_t searches = 2 * avg_gap / avg_search;
+                            spin_limit = searches <= (int64_t)policy.m_spin_count ? (uint32_t)searches : 0;
+                        }
+                    }
+                }
+                else if (idle_loops <= spin_limit) {            //spin with exponential backoff
+                    for (uint32_t i = 0; i < backoff; ++i) cpu_pause();
+                    backoff = std::min(2 * backoff, policy.m_max_backoff);
+                }
+                else [[unlikely]] {                             //if none found too long let thread sleep
+                    if (policy.m_adaptive && spin_limit > 0 && !parked) {
+                        int64_t search = duration_cast<nanoseconds>(high_resolution_clock::now() - idle_start).count() / idle_loops;
+                        avg_search = avg_search == 0 ? search : avg_search + (search - avg_search) / 8;
+                    }
+                    parked = true;
+                    m_delete.clear();       //delete jobs to reclaim memory
+                    auto& counters = *m_counters[m_thread_index.value];
+                    thread_counters::add(counters.m_parks);
+                    bool active = is_active(m_thread_index.value);
+                    if (m_parking[m_thread_groups[m_thread_index.value]]->park(m_thread_index.value, [&]() { return has_work(m_thread_index.value); }, policy.m_park_timeout, active)) {
+                        thread_counters::add(counters.m_wakeups);
+                        idle_loops = 1;                         //woken up for a job, so search and spin again
+                        backoff = 1;
+                    }
+                    else if (active && m_elastic_auto.load(std::memory_order::relaxed)) {
+                        shrink_if_idle(high_resolution_clock::now() - last_job);    //timed out, so there is not enough work
+                    }
+                }
+            };
+
+            thread_exit();
         };
 
+        /**
+        * \brief The calling thread enters the pool as a worker and runs jobs until the job system is terminated.
+        *
+        * Only threads below start_idx are not started by the job system, so with start_idx = 1 the main thread
+        * can become worker 0 and run the jobs pinned to thread 0, e.g. for GUI or graphics APIs that must run on the main thread.
+        * Returns when all threads have exited.
+        *
+        * \param[in] index The index of the calling thread, must be below start_idx.
+        */
+        void enter(thread_index_t index = thread_index_t(0)) noexcept {
+            if (can_enter(index) || m_thread_index.value == index.value) thread_task(index);
+            wait_for_termination();
+        }
+
+        /**
+        * \brief The calling thread runs jobs as a worker until it finds no job or the time budget is used up.
+        *
+        * For threads that have their own loop, e.g. a main thread that also handles window events. The first call makes
+        * the calling thread a worker, see enter(). It does not park, and it does not leave the pool before it calls
+        * wait_for_termination().
+        *
+        * \param[in] budget Maximum time for running jobs, a running job is not interrupted. 0 means until no job is found.
+        * \param[in] index The index of the calling thread, must be below start_idx.
+        * \returns the number of jobs that were run.
+        */
+        uint32_t poll(std::chrono::microseconds budget = std::chrono::microseconds(0), thread_index_t index = thread_index_t(0)) noexcept {
+            if (m_thread_index.value != index.value) {
+                if (!can_enter(index)) return 0;
+                thread_start(index);
+            }
+            if (m_affinity_epoch.load(std::memory_order::relaxed) != m_applied_epoch) [[unlikely]] {
+                m_applied_epoch = apply_affinity();                         //the affinity policy has changed
+            }
+            auto start = high_resolution_clock::now();
+            uint32_t num = 0;
+            while (!m_terminate && next_job()) {
+                run_current_job();
+                ++num;
+                if (budget.count() > 0 && high_resolution_clock::now() - start >= budget) break;
+            }
+            m_delete.clear();       //delete jobs to reclaim memory
+            return num;
+        }
+
         /**
         * \brief An old Job can be recycled.
         *
         * There is one recycle queue that can store old Jobs.
-        * If it is full then put the Job to the delete queue.
+        * If it is full or the Job was allocated on another NUMA node, then put the Job to the delete queue.
         *
         * \param[in] job Pointer to the finished Job.
         */
         void recycle(Job* job) noexcept {
-            if (m_recycle.size() <= c_queue_capacity) {
+            if (m_recycle.size() <= c_queue_capacity && job->m_node == m_node) {
                 m_recycle.push(job);        //save it so it can be reused later
             }
             else {
@@ -625,118 +2583,473 @@ namespace vgjs {
 
         /**
         * \brief Terminate the job system.
+        *
+        * The workers leave the pool after they have finished their current jobs. If a worker waits for children, see wait(),
+        * then all workers go on running jobs until it has stopped waiting.
         */
         void terminate() noexcept {
             m_terminate = true;
+            for (auto& parking : m_parking) parking->unpark_all();     //sleeping threads must see the flag
         }
 
         /**
         * \brief Wait for termination of all jobs.
         *
         * Can be called by the main thread to wait for all threads to terminate.
+        * A thread that entered the pool with poll() runs jobs until the job system is terminated.
         * Returns as soon as all threads have exited.
         */
         void wait_for_termination() noexcept {
-            while (m_terminated.load() == false) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if (m_thread_index.value >= 0 && m_thread_index.value < m_start_idx.value) {
+                thread_task(m_thread_index);    //a polling thread works until the end
+            }
+            m_terminated.wait(false);           //notified by the last thread that exits
+        };
+
+        /**
+        * \brief Wait until all children of a wait job have finished.
+        *
+        * A worker, e.g. the main thread after enter() or poll() or a thread running a Function, helps by running
+        * other jobs meanwhile and parks only if it finds none. Other threads sleep until the last child has finished.
+        * The children may reference the wait job and the stack of the waiting thread, so a thread never stops waiting
+        * while a child could still run. If the job system is terminated meanwhile, then a waiting worker delays the
+        * termination until all children have finished, and another thread sleeps until all workers have left the pool.
+        *
+        * Every job a worker runs while it waits grows its stack, and such a job may wait itself. So in more than
+        * c_max_wait_depth nested waits a worker runs only descendants of the wait job from the top of its own
+        * queues, see next_descendant(), and else parks. Only if it has parked for a whole park timeout without
+        * the children finishing, it runs any job, so that the pool cannot get stuck.
+        *
+        * \param[in] waiter The wait job, all its children must have been scheduled.
+        * \returns true if all children have finished, false if the job system was terminated before, then
+        * some children may never have run.
+        */
+        bool wait(WaitJob& waiter) noexcept {
+            bool worker = m_thread_index.value >= 0 && m_thread_index.value < (int)m_counters.size();
+            if (worker) waiter.m_waiting = m_thread_index;
+            child_finished(&waiter);                            //all children are scheduled, so the thread is no longer one of them
+
+            if (!worker) {
+                std::unique_lock<std::mutex> lock(waiter.m_mutex);
+                while (!waiter.m_cv.wait_for(lock, std::chrono::microseconds(m_park_timeout.load(std::memory_order::relaxed))
+                    , [&]() { return waiter.m_done.load() || m_terminated.load(); }));  //m_terminated is not signalled on m_cv, so look now and then
+                return waiter.m_done.load();
+            }
+
+            Job_base* current = m_current_job;                  //run other jobs on top of the current one
+            uint32_t index = m_thread_index.value;
+            bool nested = ++m_wait_depth > c_max_wait_depth;
+            m_worker_waits++;                                   //the other workers stay until the children have finished
+            while (!waiter.m_done.load()) {
+                if (nested ? next_descendant(&waiter) : next_job()) {
+                    run_current_job();
+                    continue;
+                }
+                bool woken = m_parking[m_thread_groups[index]]->park(index, [&]() { return waiter.m_done.load() || (!nested && has_work(index)); }
+                    , std::chrono::microseconds(m_park_timeout.load(std::memory_order::relaxed)), is_active(index) && !nested);
+                if (nested && !woken && !waiter.m_done.load() && next_job()) {
+                    run_current_job();                          //no other thread has helped, so grow the stack after all
+                }
+            }
+            --m_wait_depth;
+            if (m_worker_waits.fetch_sub(1) == 1 && m_terminate.load()) {
+                for (auto& parking : m_parking) parking->unpark_all();     //the last wait has ended, so the workers can leave now
+            }
+            m_current_job = current;
+            std::lock_guard<std::mutex> lock(waiter.m_mutex);   //the signalling thread has released the mutex
+            return waiter.m_done.load();
+        }
+
+    private:
+
+        /**
+        * \brief Take the job of the own next slot or the top job of the own global queues, if it is a given job or descends from it.
+        *
+        * Jobs below the top are not looked at, so a job that does not descend blocks the ones below it.
+        *
+        * \param[in] ancestor The job, e.g. a wait job, which is scheduled when its last child has finished.
+        * \returns true if such a job has been found, it is then the current job.
+        */
+        bool next_descendant(Job_base* ancestor) noexcept {
+            auto descends = [&](Job_base* job) {                //the parents are alive, since the job has not finished
+                while (job != nullptr && job != ancestor) job = job->m_parent;
+                return job != nullptr;
+            };
+            Job_base* next = m_next_slots[m_thread_index.value]->m_job.load(std::memory_order::relaxed);
+            if (next != nullptr && descends(next) && (next = take_next()) != nullptr) {
+                m_current_job = next;
+                return true;
+            }
+            for (uint32_t p = 0; p < c_num_priorities; ++p) {
+                auto& queue = m_global_queues[m_thread_index.value][p];
+                Job_base* job = queue.pop();
+                if (job == nullptr) continue;
+                if (!descends(job)) {
+                    queue.push(job);                            //put it back to the top
+                    return false;
+                }
+                count_high(job, -1);
+                count_queued(m_thread_groups[m_thread_index.value], -1);
+                m_current_job = job;
+                return true;
+            }
+            return false;
+        }
+
+    public:
+
+        /**
+        * \brief A long running job lets the jobs run that wait for its worker, then it goes on.
+        *
+        * These are the jobs pinned to the worker, and high priority jobs. They run on top of the current job, at most c_max_yield of them.
+        *
+        * \returns the number of jobs that were run.
+        */
+        uint32_t yield() noexcept {
+            if (m_thread_index.value < 0 || m_thread_index.value >= (int)m_counters.size()) return 0;
+            Job_base* current = m_current_job;
+            uint32_t num = 0;
+            for (uint32_t p = 0; p < c_num_priorities && num < c_max_yield; ) {
+                Job_base* job = (int)p == priority_high ? find_job(p) : m_local_queues[m_thread_index.value][p].pop();
+                if (job != nullptr && (int)p != priority_high) count_wait(job, true);
+                if (job == nullptr) {
+                    ++p;
+                    continue;
+                }
+                m_current_job = job;
+                run_current_job();
+                ++num;
+            }
+            m_current_job = current;
+            return num;
+        }
+
+        /**
+        * \brief Call yield() if the current job has been running for longer than a time budget since it started or yielded last.
+        *
+        * The time is measured from the first call in each run of the job, so the first call never yields.
+        * run_current_job() starts every run over, and keeps the state of a job that the run interrupts.
+        *
+        * \param[in] budget The time the job may run without yielding.
+        * \returns true if the job has yielded.
+        */
+        bool yield_if_needed(std::chrono::microseconds budget) noexcept {
+            auto now = high_resolution_clock::now();
+            if (m_yield_job != m_current_job) {
+                m_yield_job = m_current_job;
+                m_yield_time = now;
+                return false;
+            }
+            if (now - m_yield_time < budget) return false;
+            yield();
+            m_yield_job = m_current_job;            //jobs run by yield() may have changed it
+            m_yield_time = high_resolution_clock::now();
+            return true;
+        }
+
+        /**
+        * \brief Get a pointer to the current job.
+        * \returns a pointer to the current job.
+        */
+        static Job_base* current_job() noexcept {
+            return m_current_job;
+        }
+
+        /**
+        * \brief Get the thread index the current job is running on.
+        * \returns the index of the thread the current job is running on, or -1.
+        */
+        thread_index_t get_thread_index() {
+            return m_thread_index;
+        }
+
+        /**
+        * \brief Get the number of threads in the system.
+        * \returns the number of threads in the system.
+        */
+        thread_count_t get_thread_count() {
+            return thread_count_t( m_thread_count.load() );
+        }
+
+        /**
+        * \brief Get the memory resource used for allocating job structures.
+        * \returns the memory resource used for allocating job structures.
+        */
+        n_pmr::memory_resource* memory_resource() {
+            return m_mr;
+        }
+
+    private:
+
+        /**
+        * \brief A job without a priority or deadline gets the ones of its parent, jobs without parent have normal priority.
+        * \param[in] job The job.
+        */
+        void inherit(Job_base* job) noexcept {
+            if (job->m_priority.value < 0 || job->m_priority.value >= (int)c_num_priorities) {    //inherit the priority
+                job->m_priority = (job->m_parent != nullptr && job->m_parent->m_priority.value >= 0) ? job->m_parent->m_priority : priority_normal;
+            }
+            if (job->m_deadline == no_deadline && job->m_parent != nullptr) {
+                job->m_deadline = job->m_parent->m_deadline;    //inherit the deadline
+            }
+        }
+
+    public:
+
+        /**
+        * \brief Schedule a job into the job system.
+        * The Job will be put into a thread's queue for consumption. A worker thread pushes
+        * jobs onto its own work stealing deque, other threads use the inject queues.
+        * In deadline scheduling mode jobs with a deadline go into deadline queues instead.
+        * A job whose type belongs to another worker group goes into a queue of that group.
+        *
+        * \param[in] job A pointer to the job to schedule.
+        */
+        uint32_t schedule_job(Job_base* job, tag_t tg = tag_t{}) noexcept {
+            assert(job!=nullptr);
+
+            if ( tg.value >= 0 ) {                  //tagged scheduling
+                m_tags.get_or_create(tg, m_thread_count.load() + 1)->push(job, m_thread_index.value); //save for later
+                return 0;
+            }
+
+            inherit(job);
+            stamp(job);
+            uint32_t prio = job->m_priority.value;
+            bool edf = m_deadline_scheduling && job->m_deadline != no_deadline;
+
+            if (m_batch_depth > 0) {                //collect jobs, they are pushed by end_batch()
+                if (job->m_thread_index.value < 0 || job->m_thread_index.value >= (int)m_thread_count) {
+                    if (m_batch_global.size() < m_group_threads.size()) {
+                        m_batch_global.resize(m_group_threads.size());
+                        m_batch_deadline.resize(m_group_threads.size());
+                    }
+                    if (edf) m_batch_deadline[group_of(job)][prio].push(job);
+                    else m_batch_global[group_of(job)][prio].push(job);
+                }
+                else {
+                    if (m_batch_local.size() < m_thread_count) m_batch_local.resize(m_thread_count);
+                    m_batch_local[job->m_thread_index.value][prio].push(job);
+                }
+                return 1;
+            }
+
+            count_high(job, 1);
+
+            if (job->m_thread_index.value < 0 || job->m_thread_index.value >= (int)m_thread_count ) {
+                uint32_t group = group_of(job);
+                count_queued(group, 1);
+                if (in_group(group)) {
+                    if (edf ? m_deadline_queues[m_thread_index.value][prio].push(job)
+                            : m_global_queues[m_thread_index.value][prio].push(job)) {   //a worker owns its deque
+                        wake_threads(1);            //wake up a thief only if the queue was empty
+                    }
+                }
+                else {                              //from outside the pool or from another group
+                    thread_index_t thread_index = next_in_group(group);
+                    if (edf ? m_deadline_queues[thread_index][prio].push(job) : m_inject_queues[thread_index][prio].push(job)) {
+                        wake_threads(1, thread_index);  //prefer the owner of the queue
+                    }
+                }
+                return 1;
             }
+
+            m_local_queues[job->m_thread_index.value][prio].push(job); //to a specific thread
+            wake_thread(job->m_thread_index);   //only this thread can run the job
+            return 1;
         };
 
+    private:
+
         /**
-        * \brief Get a pointer to the current job.
-        * \returns a pointer to the current job.
+        * \brief Schedule a job that became ready, i.e. a coro whose children have finished, or a continuation.
+        *
+        * A worker puts the job into its next slot and runs it next, while its data is still in the cache.
+        * A job that was in the slot before goes into the worker's global queue. Jobs for a specific thread
+        * or another worker group, jobs with a deadline in deadline scheduling mode, and jobs readied
+        * during a batch or outside of the pool are scheduled normally.
+        *
+        * \param[in] job A pointer to the job to schedule.
         */
-        static Job_base* current_job() noexcept {
-            return m_current_job;
+        uint32_t schedule_next(Job_base* job) noexcept {
+            if (m_batch_depth > 0 || (job->m_thread_index.value >= 0 && job->m_thread_index.value < (int)m_thread_count)
+                || job->m_priority.value < 0 || job->m_priority.value >= (int)c_num_priorities
+                || (m_deadline_scheduling && job->m_deadline != no_deadline) || !in_group(group_of(job))) {
+                return schedule_job(job);
+            }
+
+            count_high(job, 1);
+            stamp(job);
+            Job_base* old = m_next_slots[m_thread_index.value]->put(job);
+            if (old != nullptr) {
+                count_queued(m_thread_groups[m_thread_index.value], 1);
+                if (m_global_queues[m_thread_index.value][old->m_priority.value].push(old)) {
+                    wake_threads(1);                //the older job can be stolen right away
+                }
+            }
+            return 1;
         }
 
+    public:
+
         /**
-        * \brief Get the thread index the current job is running on.
-        * \returns the index of the thread the current job is running on, or -1.
+        * \brief Start collecting scheduled jobs instead of pushing them one by one.
+        *
+        * Until the matching end_batch() call, untagged jobs scheduled by this thread are
+        * linked into one chain per target queue. Batches can be nested, only the outermost
+        * end_batch() pushes the jobs.
         */
-        thread_index_t get_thread_index() {
-            return m_thread_index;
+        void begin_batch() noexcept {
+            ++m_batch_depth;
         }
 
         /**
-        * \brief Get the number of threads in the system.
-        * \returns the number of threads in the system.
+        * \brief Push all jobs collected since begin_batch(), one splice per target queue, then wake up threads for them.
+        * \returns the number of jobs that were pushed.
         */
-        thread_count_t get_thread_count() {
-            return thread_count_t( m_thread_count.load() );
+        uint32_t end_batch() noexcept {
+            if (m_batch_depth == 0 || --m_batch_depth > 0) return 0;
+
+            uint32_t num = 0;
+            for (uint32_t g = 0; g < m_batch_global.size(); ++g) {
+                bool own = in_group(g);                 //a worker pushes jobs of its own group onto its deque
+                thread_index_t index = own ? m_thread_index : thread_index_t{};
+                for (uint32_t p = 0; p < c_num_priorities; ++p) {
+                    auto& chain = m_batch_global[g][p];
+                    if (chain.m_size > 0) {
+                        if ((int)p == priority_high) m_high_jobs[g]->fetch_add(chain.m_size, std::memory_order::relaxed);
+                        count_queued(g, chain.m_size);
+                        if (own) {
+                            if (m_global_queues[index][p].push(chain.m_first, chain.m_last, chain.m_size)) {
+                                wake_threads(chain.m_size);     //one thread per new job
+                            }
+                        }
+                        else {
+                            if (index.value < 0) index = next_in_group(g);
+                            if (m_inject_queues[index][p].push(chain.m_first, chain.m_last, chain.m_size)) {
+                                wake_threads(chain.m_size, index);
+                            }
+                        }
+                        num += chain.m_size;
+                        chain.clear();
+                    }
+                    auto& deadline = m_batch_deadline[g][p];
+                    if (deadline.m_size > 0) {
+                        if ((int)p == priority_high) m_high_jobs[g]->fetch_add(deadline.m_size, std::memory_order::relaxed);
+                        count_queued(g, deadline.m_size);
+                        if (index.value < 0) index = next_in_group(g);
+                        if (m_deadline_queues[index][p].push(deadline.m_first, deadline.m_last, deadline.m_size)) {
+                            wake_threads(deadline.m_size, own ? thread_index_t{} : index);
+                        }
+                        num += deadline.m_size;
+                        deadline.clear();
+                    }
+                }
+            }
+            for (uint32_t i = 0; i < m_batch_local.size(); ++i) {
+                uint32_t num_local = 0;
+                for (uint32_t p = 0; p < c_num_priorities; ++p) {
+                    auto& chain = m_batch_local[i][p];
+                    if (chain.m_size == 0) continue;
+                    m_local_queues[i][p].push(chain.m_first, chain.m_last, chain.m_size);
+                    num_local += chain.m_size;
+                    chain.clear();
+                }
+                if (num_local > 0) wake_thread(thread_index_t((int)i));
+                num += num_local;
+            }
+            return num;
         }
 
+
         /**
-        * \brief Get the memory resource used for allocating job structures.
-        * \returns the memory resource used for allocating job structures.
+        * \brief Register a tag, so that scheduling jobs with this tag does not allocate its queue.
+        * Tags that are not registered get their queue when the first job is scheduled with them.
+        * \param[in] tg The tag.
         */
-        n_pmr::memory_resource* memory_resource() {
-            return m_mr;
+        void register_tag(tag_t tg) {
+            if (tg.value >= 0) m_tags.get_or_create(tg, m_thread_count.load() + 1);
         }
 
+    private:
+
         /**
-        * \brief Schedule a job into the job system.
-        * The Job will be put into a thread's queue for consumption.
+        * \brief Take chunks of jobs out of a released tag and schedule them, until the budgets of all shards are used up.
         *
-        * \param[in] job A pointer to the job to schedule.
+        * Each chunk is popped from a shard in one operation and pushed into this thread's queues with one splice.
+        * A thread starts with its own shard, so threads that pull from the same tag at the same time do not meet.
+        * Shards are FIFO and a shard's budget is its size at the release, so jobs pushed meanwhile stay in the tag.
+        *
+        * \param[in] queue The queue of the tag.
+        * \param[in] budgets Number of jobs that are still to be scheduled from each shard, shared by all pulling threads.
+        * \param[in] parent The parent of the jobs.
+        * \returns the number of scheduled jobs.
         */
-        uint32_t schedule_job(Job_base* job, tag_t tg = tag_t{}) noexcept {
-            thread_local static thread_index_t thread_index(rand() % m_thread_count);
-
-            assert(job!=nullptr);
-
-            if ( tg.value >= 0 ) {                  //tagged scheduling
-                if(!m_tag_queues.contains(tg)) {
-                    m_tag_queues[tg] = std::make_unique<JobQueue<Job_base>>();
+        uint32_t pull_tag(TagQueue* queue, std::atomic<int32_t>* budgets, Job_base* parent) noexcept {
+            uint32_t res = 0;
+            uint32_t s = m_thread_index.value >= 0 ? m_thread_index.value % queue->m_num_shards : 0;
+            for (uint32_t done = 0; done < queue->m_num_shards; ) {
+                int32_t claim = budgets[s].fetch_sub(c_tag_chunk, std::memory_order::relaxed);
+                uint32_t num = claim > 0 ? std::min((uint32_t)claim, c_tag_chunk) : 0;
+                Job_base* first;
+                Job_base* last;
+                uint32_t n = num > 0 ? queue->m_shards[s].pop(num, first, last) : 0;
+                if (claim <= (int32_t)c_tag_chunk || n < num) {     //the budget of this shard is used up, go on with the next one
+                    s = (s + 1) % queue->m_num_shards;
+                    ++done;
+                }
+                if (n == 0) continue;
+                begin_batch();
+                for (uint32_t j = 0; j < n; ++j) {
+                    Job_base* job = first;
+                    first = (Job_base*)first->m_next.load(std::memory_order::relaxed);   //scheduling overwrites m_next
+                    job->m_parent = parent;
+                    schedule_job(job, tag_t{});
+                }
+                end_batch();
+                res += n;
+                if (m_thread_index.value >= 0 && m_thread_index.value < (int)m_counters.size()) {
+                    thread_counters::add(m_counters[m_thread_index.value]->m_tag_chunks);
                 }
-                m_tag_queues.at(tg)->push(job); //save for later
-                return 0;
-            }
-
-            if (job->m_thread_index.value < 0 || job->m_thread_index.value >= (int)m_thread_count ) {
-                thread_index.value = (++thread_index.value) >= (decltype(thread_index.value))m_thread_count ? 0 : thread_index.value;
-                m_global_queues[thread_index].push(job);
-                //m_cv[thread_index.value]->notify_one();       //wake up the thread
-                m_cv[0]->notify_all();       //wake up the thread
-                return 1;
             }
+            return res;
+        }
 
-            m_local_queues[job->m_thread_index.value].push(job); //to a specific thread
-            //m_cv[job->m_thread_index]->notify_one();
-            m_cv[0]->notify_all();       //wake up the thread
-            return 1;
-        };
-
+    public:
 
         /**
         * \brief Schedule all Jobs from a tag
+        *
+        * A large tag is not distributed by this thread alone. Helper jobs are scheduled that other workers steal,
+        * and all of them, including this thread, pull chunks of jobs from the tag in parallel, see pull_tag().
+        *
         * \param[in] tg The tag that is scheduled
         * \param[in] parent The parent of this Job.
         * \param[in] children Number used to increase the number of children of the parent.
         * \returns the number of scheduled jobs.
         */
         uint32_t schedule_tag( tag_t& tg, tag_t tg2 = tag_t{}, Job_base* parent = m_current_job, int32_t children = -1) noexcept {
-            if (!m_tag_queues.contains(tg)) return 0;
-
-            JobQueue<Job_base>* queue = m_tag_queues[tg].get();   //get the queue for this tag
-            uint32_t num_jobs = queue->size();
+            TagQueue* queue = m_tags.get(tg);    //get the queue for this tag
+            if (queue == nullptr) return 0;
+            std::shared_ptr<std::atomic<int32_t>[]> budgets = std::make_unique<std::atomic<int32_t>[]>(queue->m_num_shards);
+            uint32_t num_jobs = queue->size(budgets.get()); //schedule only these jobs, since someone could add more jobs now
+            if (num_jobs == 0) return 0;
 
             if (parent != nullptr) {
                 if (children < 0) children = num_jobs;     //if the number of children is not given, then use queue size
                 parent->m_children.fetch_add((int)children);    //add this number to the number of children of parent
             }
 
-            uint32_t num = num_jobs;        //schedule at most num_jobs, since someone could add more jobs now
-            int i = 0;
-            while ( num>0 ) {     //schedule all jobs from the tag queue
-                Job_base* job = queue->pop();
-                if (!job) return i;
-                job->m_parent = parent;
-                schedule_job(job, tag_t{});
-                --num;
-                ++i;
+            uint32_t helpers = std::min(num_jobs / c_tag_chunk, m_thread_count.load()) - (num_jobs >= c_tag_chunk ? 1 : 0);
+            if (helpers == 0) return pull_tag(queue, budgets.get(), parent);
+
+            begin_batch();
+            for (uint32_t h = 0; h < helpers; ++h) {    //helpers are children of the parent too
+                schedule([=]() { JobSystem().pull_tag(queue, budgets.get(), parent); }, tag_t{}, parent);
             }
-            return i;
+            end_batch();
+            pull_tag(queue, budgets.get(), parent);
+            return num_jobs;
         };
 
 
@@ -746,15 +3059,17 @@ namespace vgjs {
         * \param[in] tg The tag that is scheduled
         * \param[in] parent The parent of this Job.
         * \param[in] children Number used to increase the number of children of the parent.
+        * \param[in] prio Priority of the job, if the function does not have one. If empty then the job inherits the priority of its parent.
         */
         template<typename F>
         requires FUNCTOR<F> || std::is_same_v<std::decay_t<F>, tag_t>
-        uint32_t schedule(F&& function, tag_t tg = tag_t{}, Job_base* parent = m_current_job, int32_t children = -1) noexcept {
+        uint32_t schedule(F&& function, tag_t tg = tag_t{}, Job_base* parent = m_current_job, int32_t children = -1, priority_t prio = priority_t{}) noexcept {
             if constexpr (std::is_same_v<std::decay_t<F>, tag_t>) {
                 return schedule_tag(function, tg, parent, children);
             }
             else {
                 Job* job = allocate_job(std::forward<F>(function));
+                if (job->m_priority.value < 0) job->m_priority = prio;
                 job->m_parent = nullptr;
                 if (tg.value < 0) {
                     job->m_parent = parent;
@@ -830,6 +3145,316 @@ namespace vgjs {
             return m_logging;
         }
 
+        /**
+        * \brief Enable steal half mode.
+        * A thief then moves about half of the victim's queued jobs into its own queue in one go,
+        * instead of stealing only one job per attempt.
+        */
+        void enable_steal_half() {
+            m_steal_half = true;
+        }
+
+        /**
+        * \brief Disable steal half mode, thieves steal one job per attempt.
+        */
+        void disable_steal_half() {
+            m_steal_half = false;
+        }
+
+        /**
+        * \brief Ask whether steal half mode is currently enabled or not
+        * \returns true or false
+        */
+        bool is_steal_half() {
+            return m_steal_half;
+        }
+
+        /**
+        * \brief Set the fairness burst.
+        * A thread runs at most this many jobs in a row from its local queues (pinned jobs), from its next slot,
+        * or from its own global queue, then it looks into the other queues first once. 0 switches this off.
+        * \param[in] burst Maximum number of jobs in a row.
+        */
+        void set_fair_burst(uint32_t burst) {
+            m_fair_burst = burst;
+        }
+
+        /**
+        * \brief Get the fairness burst.
+        * \returns the maximum number of jobs in a row from the local queues or the next slot.
+        */
+        uint32_t get_fair_burst() {
+            return m_fair_burst;
+        }
+
+        /**
+        * \brief Enable wait statistics.
+        * Jobs are then time stamped when they are queued, and the time they waited is added to the statistics,
+        * separately for the local queues and all other queues. This costs a clock read per job.
+        */
+        void enable_wait_statistics() {
+            m_wait_since = high_resolution_clock::now().time_since_epoch().count();
+            m_wait_statistics = true;
+        }
+
+        /**
+        * \brief Disable wait statistics.
+        */
+        void disable_wait_statistics() {
+            m_wait_statistics = false;
+        }
+
+        /**
+        * \brief Ask whether wait statistics are currently enabled or not
+        * \returns true or false
+        */
+        bool is_wait_statistics() {
+            return m_wait_statistics;
+        }
+
+        /**
+        * \brief Enable deadline scheduling mode.
+        * Within each priority class, jobs with a deadline are then run earliest deadline first,
+        * before jobs without a deadline. Jobs for a specific thread are still run in FIFO order.
+        */
+        void enable_deadline_scheduling() {
+            m_deadline_scheduling = true;
+        }
+
+        /**
+        * \brief Disable deadline scheduling mode, deadlines are then only used for counting deadline misses.
+        */
+        void disable_deadline_scheduling() {
+            m_deadline_scheduling = false;
+        }
+
+        /**
+        * \brief Ask whether deadline scheduling mode is currently enabled or not
+        * \returns true or false
+        */
+        bool is_deadline_scheduling() {
+            return m_deadline_scheduling;
+        }
+
+        /**
+        * \brief Enable running continuations right away on the thread that finished their predecessor.
+        * This bypasses the queues, each nested continuation grows the stack.
+        * \param[in] max_depth Maximum nesting depth, deeper continuations are scheduled normally.
+        */
+        void enable_inline_continuations(uint32_t max_depth = 16) {
+            m_max_inline_depth = max_depth;
+        }
+
+        /**
+        * \brief Disable running continuations right away, they are then always scheduled.
+        */
+        void disable_inline_continuations() {
+            m_max_inline_depth = 0;
+        }
+
+        /**
+        * \brief Ask whether continuations are run right away or not
+        * \returns true or false
+        */
+        bool is_inline_continuations() {
+            return m_max_inline_depth > 0;
+        }
+
+    private:
+
+        /**
+        * \brief Test whether the calling thread may run a job that became ready right away, instead of scheduling it.
+        *
+        * This is the case on a worker of the job's group outside of a batch, if the job is not meant for another
+        * thread, and if it does not jump ahead of high priority jobs that this worker could run, see high_jobs_waiting(),
+        * or of jobs with earlier deadlines in deadline scheduling mode.
+        *
+        * \param[in] job The job.
+        * \returns true if the job may run right away.
+        */
+        bool can_run_now(Job_base* job) noexcept {
+            if (m_batch_depth > 0 || !in_group(group_of(job))) return false;
+            if (job->m_thread_index.value >= 0 && job->m_thread_index.value != m_thread_index.value) return false;
+            if (job->m_priority.value != priority_high && high_jobs_waiting()) return false;
+            return !(m_deadline_scheduling && job->m_deadline != no_deadline);
+        }
+
+        /**
+        * \brief Run a continuation right away on this thread, instead of scheduling it.
+        *
+        * This is done only if enabled, below the maximum nesting depth, and if can_run_now() allows it.
+        *
+        * \param[in] job The continuation.
+        * \returns true if the continuation has been run, else it must be scheduled.
+        */
+        bool run_inline(Job_base* job) noexcept {
+            if (m_inline_depth >= m_max_inline_depth.load(std::memory_order::relaxed) || !job->is_function() || !can_run_now(job)) return false;
+
+            thread_counters::add(m_counters[m_thread_index.value]->m_inline_continuations);
+            Job_base* current = m_current_job;
+            m_current_job = job;
+            ++m_inline_depth;
+            high_resolution_clock::time_point t1, t2;
+            if constexpr (c_enable_logging) {
+                if (is_logging()) t1 = high_resolution_clock::now();
+            }
+            Job_base* yield_job = m_yield_job;          //the continuation runs on top of the current job, see yield_if_needed()
+            auto yield_time = m_yield_time;
+            m_yield_job = nullptr;                      //a recycled Job at the same address starts over
+
+            (*job)();
+
+            m_yield_job = yield_job;
+            m_yield_time = yield_time;
+            if constexpr (c_enable_logging) {
+                if (is_logging()) {
+                    t2 = high_resolution_clock::now();
+                    log_data(t1, t2, m_thread_index, false, job->m_type, job->m_id);
+                }
+            }
+            child_finished(job);        //may run the next continuation
+            --m_inline_depth;
+            m_current_job = current;
+            return true;
+        }
+
+        /**
+        * \brief Make a coro the current job, so it can be resumed right away by symmetric transfer,
+        * e.g. from its last child, or from its parent if it is the only child.
+        * \param[in] job The promise of the coro.
+        * \returns true if the coro must be resumed right away, else it must be scheduled.
+        */
+        bool resume_now(Job_base* job) noexcept {
+            if (job->is_function() || !can_run_now(job)) return false;
+            m_current_job = job;
+            return true;
+        }
+
+    public:
+
+        /**
+        * \brief Count a finished job with a deadline, and whether it missed its deadline.
+        * \param[in] job The job that has finished.
+        */
+        void count_deadline(Job_base* job) noexcept {
+            if (job->m_deadline == no_deadline) return;
+            if (m_thread_index.value < 0 || m_thread_index.value >= (int)m_counters.size()) return;
+            auto& counters = *m_counters[m_thread_index.value];
+            thread_counters::add(counters.m_deadline_jobs);
+            if (high_resolution_clock::now() > job->m_deadline) {
+                thread_counters::add(counters.m_deadline_misses);
+            }
+        }
+
+        /**
+        * \brief Set what threads do when they do not find a job. Takes effect when a thread runs out of jobs the next time.
+        * \param[in] policy The new idle policy.
+        */
+        void set_idle_policy(const IdlePolicy& policy) {
+            m_spin_count = policy.m_spin_count;
+            m_max_backoff = std::max(policy.m_max_backoff, 1u);
+            m_park_timeout = std::max(policy.m_park_timeout.count(), (int64_t)1);
+            m_adaptive_idle = policy.m_adaptive;
+        }
+
+        /**
+        * \brief Get the current idle policy.
+        * \returns the current idle policy.
+        */
+        IdlePolicy get_idle_policy() {
+            return { m_spin_count.load(), m_max_backoff.load(), std::chrono::microseconds(m_park_timeout.load()), m_adaptive_idle.load() };
+        }
+
+        /**
+        * \brief Set how worker threads are pinned to logical CPUs. Each thread pins itself before it looks for its next job.
+        * \param[in] policy The new affinity policy.
+        */
+        void set_affinity(const AffinityPolicy& policy) {
+            {
+                std::lock_guard<std::mutex> lock(m_affinity_mutex);
+                m_affinity = policy;
+                m_affinity_cpus = policy.cpus(m_thread_count);
+                m_topology = cpu_topology();
+                m_affinity_epoch++;
+            }
+            for (auto& parking : m_parking) parking->unpark_all();     //parked threads apply the policy right away
+        }
+
+        /**
+        * \brief Set the number of active threads of a worker group.
+        *
+        * The first num threads of the group are active, the others hand off their jobs to the active threads,
+        * run only jobs that are pinned to them, and park. They are not stolen from and not woken up for new jobs.
+        * In automatic elastic mode the number changes again with the load.
+        *
+        * \param[in] num The number of active threads, at least 1 and at most the number of threads of the group.
+        * \param[in] group The index of the worker group.
+        */
+        void set_active_threads(thread_count_t num, uint32_t group = 0) {
+            if (group >= m_group_threads.size()) return;
+            m_active_threads[group]->store((uint32_t)std::clamp(num.value, 1, (int)m_group_threads[group].size()));
+            m_parking[group]->unpark_all();     //parked threads see whether they are active, and re-park accordingly
+        }
+
+        /**
+        * \brief Get the number of active threads of a worker group.
+        * \param[in] group The index of the worker group.
+        * \returns the number of active threads of the group.
+        */
+        thread_count_t get_active_threads(uint32_t group = 0) {
+            if (group >= m_group_threads.size()) return thread_count_t( 0 );
+            return thread_count_t( m_active_threads[group]->load() );
+        }
+
+        /**
+        * \brief Set how the number of active threads follows the load.
+        * \param[in] policy The new elastic policy.
+        */
+        void set_elastic_policy(const ElasticPolicy& policy) {
+            m_elastic_min = std::max(policy.m_min_threads, 1u);
+            m_elastic_max = policy.m_max_threads;
+            m_grow_depth = policy.m_grow_depth;
+            m_shrink_idle = std::max(policy.m_shrink_idle.count(), (int64_t)0);
+            m_elastic_auto = policy.m_auto;
+        }
+
+        /**
+        * \brief Get the current elastic policy.
+        * \returns the current elastic policy.
+        */
+        ElasticPolicy get_elastic_policy() {
+            return { m_elastic_auto.load(), m_elastic_min.load(), m_elastic_max.load(), m_grow_depth.load(), std::chrono::microseconds(m_shrink_idle.load()) };
+        }
+
+        /**
+        * \brief Get the current affinity policy.
+        * \returns the current affinity policy.
+        */
+        AffinityPolicy get_affinity() {
+            std::lock_guard<std::mutex> lock(m_affinity_mutex);
+            return m_affinity;
+        }
+
+        /**
+        * \brief Get the scheduling counters of a thread, or the sum over all threads.
+        * \param[in] index The thread index, or an empty index for the sum over all threads.
+        * \returns the scheduling counters.
+        */
+        JobStatistics get_statistics(thread_index_t index = thread_index_t{}) {
+            JobStatistics res;
+            for (uint32_t i = 0; i < m_counters.size(); ++i) {
+                if (index.value < 0 || index.value == (int)i) res += m_counters[i]->get();
+            }
+            return res;
+        }
+
+        /**
+        * \brief Reset the scheduling counters of all threads.
+        */
+        void clear_statistics() {
+            for (auto& counters : m_counters) counters->clear();
+        }
+
         /**
         * \brief Get the the time when the job system was started (for logging)
         * \returns the time the job system was started
@@ -863,6 +3488,7 @@ namespace vgjs {
     * Then, if there is a parent, the parent's child_finished() function is called.
     */
     inline void JobSystem::on_finished(Job *job) noexcept {
+        count_deadline(job);
 
         if (job->m_continuation != nullptr) {		//is there a successor Job?
 
@@ -870,7 +3496,15 @@ namespace vgjs {
                 job->m_parent->m_children++;
                 job->m_continuation->m_parent = job->m_parent;   //add successor as child to the parent
             }
-            schedule_job(job->m_continuation);    //schedule the successor
+            if (job->m_continuation->m_priority.value < 0) {
+                job->m_continuation->m_priority = job->m_priority;  //successor inherits the priority
+            }
+            if (job->m_continuation->m_deadline == no_deadline) {
+                job->m_continuation->m_deadline = job->m_deadline;  //and the deadline
+            }
+            if (!run_inline(job->m_continuation)) {
+                schedule_next(job->m_continuation);   //schedule the successor
+            }
         }
 
         if (job->m_parent != nullptr) {		//if there is parent then inform it
@@ -881,6 +3515,26 @@ namespace vgjs {
     }
 
 
+    /**
+    * \brief Signal the waiting thread that all children have finished.
+    *
+    * The waiting thread may destroy this job as soon as it sees m_done, so m_done is set while holding the mutex,
+    * and only copies are used afterwards.
+    *
+    * \returns true.
+    */
+    inline bool WaitJob::resume() noexcept {
+        thread_index_t waiting = m_waiting;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done = true;
+            m_cv.notify_all();
+        }
+        if (waiting.value >= 0) JobSystem().wake_thread(waiting);   //a worker may be parked
+        return true;
+    }
+
+
     //----------------------------------------------------------------------------------
 
     /**
@@ -904,29 +3558,131 @@ namespace vgjs {
     * \param[in] functions A vector of functions to schedule
     * \param[in] parent The parent of this Job.
     * \param[in] children Number used to increase the number of children of the parent.
+    * \param[in] prio Priority for functions that do not have one, if empty they inherit the priority of the parent.
     * \returns the number of scheduled functions
     */
     template <typename F>
-    inline uint32_t schedule(F&& functions, tag_t tg = tag_t{}, Job_base* parent = current_job(), int32_t children = -1) noexcept {
+    inline uint32_t schedule(F&& functions, tag_t tg = tag_t{}, Job_base* parent = current_job(), int32_t children = -1, priority_t prio = priority_t{}) noexcept {
         if constexpr (is_pmr_vector<std::decay_t<F>>::value) {
             if (children < 0) {                     //default? use vector size.
                 children = (int)functions.size();
             }
             auto ret = children;
+            JobSystem().begin_batch();   //push all jobs with one operation per queue
             for (auto&& f : functions) { //schedule all elements, use the total number of children for the first call, then 0
                 if constexpr (std::is_lvalue_reference_v<decltype(functions)>) {
-                    schedule(f, tg, parent, children); //might call the coro version, so do not call job system here!
+                    schedule(f, tg, parent, children, prio); //might call the coro version, so do not call job system here!
                 }
                 else {
-                    schedule(std::move(f), tg, parent, children); //might call the coro version, so do not call job system here!
+                    schedule(std::move(f), tg, parent, children, prio); //might call the coro version, so do not call job system here!
                 }
                 children = 0;
             }
+            JobSystem().end_batch();
             return ret;
         }
         else {
-            return JobSystem().schedule(std::forward<F>(functions), tg, parent, children);
+            return JobSystem().schedule(std::forward<F>(functions), tg, parent, children, prio);
+        }
+    }
+
+    /**
+    * \brief Schedule functions and wait until they have finished, e.g. from a thread outside of the pool.
+    *
+    * F can be anything that schedule() accepts, e.g. Functions, lambdas, Coros, vectors of them, or a tag.
+    * Use this in threads and Functions, a coro should co_await instead.
+    *
+    * \param[in] functions The functions to schedule.
+    * \param[in] prio Priority for functions that do not have one.
+    * \returns true if they have finished, false if the job system was terminated before, then some may never have run.
+    */
+    template <typename F>
+    inline bool wait(F&& functions, priority_t prio = priority_t{}) noexcept {
+        WaitJob waiter;
+        schedule(std::forward<F>(functions), tag_t{}, &waiter, -1, prio);
+        return JobSystem().wait(waiter);
+    }
+
+    /**
+    * \brief Fork-join scope for Functions that need the results of their children.
+    *
+    * Jobs spawned into the scope are its children instead of children of the current job. wait() returns
+    * when all of them have finished, meanwhile a worker runs other jobs. The destructor also waits, so no child
+    * can outlive the scope and its children may reference local variables. The children inherit the priority
+    * and deadline of the current job. After wait() the scope can be used again.
+    */
+    class task_scope {
+        WaitJob m_waiter;
+        bool    m_pending = false;  //true if there are children that have not been waited for
+
+    public:
+        task_scope() noexcept {
+            if (Job_base* current = current_job(); current != nullptr) {
+                m_waiter.m_priority = current->m_priority;
+                m_waiter.m_deadline = current->m_deadline;
+            }
+        }
+
+        task_scope(const task_scope&) = delete;
+        task_scope& operator=(const task_scope&) = delete;
+
+        ~task_scope() noexcept {
+            if (m_pending) wait();
+        }
+
+        /**
+        * \brief Schedule functions as children of the scope.
+        * \param[in] functions Anything that schedule() accepts.
+        * \param[in] prio Priority for functions that do not have one, if empty they inherit the priority of the current job.
+        * \returns the number of scheduled functions.
+        */
+        template <typename F>
+        uint32_t spawn(F&& functions, priority_t prio = priority_t{}) noexcept {
+            m_pending = true;
+            return schedule(std::forward<F>(functions), tag_t{}, &m_waiter, -1, prio);
+        }
+
+        /**
+        * \brief Wait until all children of the scope have finished, a worker runs other jobs meanwhile.
+        * \returns true if they have finished, false if the job system was terminated before.
+        */
+        bool wait() noexcept {
+            bool done = JobSystem().wait(m_waiter);
+            m_pending = false;
+            if (!done) return false;        //terminated, the scope cannot be used again
+            m_waiter.m_children = 1;        //ready for the next round
+            m_waiter.m_done = false;
+            m_waiter.m_waiting = thread_index_t{};
+            return true;
         }
+    };
+
+    /**
+    * \brief A long running Function lets the jobs pinned to its worker and high priority jobs run, then it goes on.
+    * \returns the number of jobs that were run.
+    */
+    inline uint32_t yield() noexcept {
+        return JobSystem().yield();
+    }
+
+    /**
+    * \brief A long running Function yields if it has been running for longer than a time budget since it started or yielded last.
+    * \param[in] budget The time the Function may run without yielding.
+    * \returns true if the Function has yielded.
+    */
+    inline bool yield_if_needed(std::chrono::microseconds budget = std::chrono::microseconds(1000)) noexcept {
+        return JobSystem().yield_if_needed(budget);
+    }
+
+    /**
+    * \brief Schedule functions into the system with a given priority.
+    * \param[in] functions The functions to schedule.
+    * \param[in] prio Priority for functions that do not have one.
+    * \returns the number of scheduled functions
+    */
+    template <typename F>
+    inline uint32_t schedule(F&& functions, priority_t prio) noexcept {
+        return schedule(std::forward<F>(functions), tag_t{}, current_job(), -1, prio);
     }
 
 
@@ -1058,7 +3814,7 @@ namespace vgjs {
     }
 
     /**
-    * \brief Dump all job data into a json log file.
+    * \brief Dump all job data into a json log file, the deadline counters are written to otherData.
     */
     inline void save_log_file() {
         auto& logs = JobSystem().get_logs();
@@ -1090,6 +3846,9 @@ namespace vgjs {
                 }
             }
             outdata << "]," << std::endl;
+            auto stats = JobSystem().get_statistics();
+            outdata << "\"otherData\": {\"deadline_jobs\": " << stats.m_deadline_jobs;
+            outdata << ", \"deadline_misses\": " << stats.m_deadline_misses << "}," << std::endl;
             outdata << "\"displayTimeUnit\": \"ms\"" << std::endl;
             outdata << "}" << std::endl;
         }
@@ -37,6 +37,7 @@ namespace vgjs {
     template<typename PT> struct awaitable_tag; //schedule all jobs for a tag
     template<typename U> struct yield_awaiter;  //co_yield
     template<typename U> struct final_awaiter;  //final_suspend
+    n_exp::coroutine_handle<> resume_parent(Job_base* parent) noexcept;    //last child finished, resume the parent coro
 
     //coroutine promise classes
     class Coro_promise_base;                    //common base class independent of return type T
@@ -61,17 +62,20 @@ namespace vgjs {
     * \param[in] coro A ref to coroutine Coro, whose promise is a job that is scheduled into the job system
     * \param[in] parent The parent of this Job.
     * \param[in] children Number used to increase the number of children of the parent.
+    * \param[in] prio Priority of the Coro if it does not have one, if empty it inherits the priority of the parent.
     */
     template<typename T>
     requires CORO<T>   
-    uint32_t schedule( T&& coro, tag_t tg = tag_t{}, Job_base* parent = current_job(), int32_t children = 1) noexcept {
+    uint32_t schedule( T&& coro, tag_t tg = tag_t{}, Job_base* parent = current_job(), int32_t children = 1, priority_t prio = priority_t{}) noexcept {
         JobSystem js;
 
         auto promise = coro.promise();
+        if (promise->m_priority.value < 0) promise->m_priority = prio;
 
         promise->m_parent = parent;
         if (tg.value < 0 ) {           //schedule now
             if (parent != nullptr) {
+                if (children < 0) children = 1;
                 parent->m_children.fetch_add((int)children);       //await the completion of all children      
             }
         }
@@ -84,6 +88,35 @@ namespace vgjs {
     };
 
 
+    /**
+    * \brief Schedule a Coro and wait until it has finished, e.g. from a thread outside of the pool, see vgjs::wait().
+    * \param[in] coro The Coro, it must not have been created by another coro.
+    * \param[in] prio Priority of the Coro if it does not have one.
+    * \returns the promised value. If the job system was terminated before the Coro has finished, this is the value
+    * the Coro has not set yet, i.e. a value-initialized T.
+    */
+    template<typename T>
+    requires (!std::is_void_v<T>)
+    T wait(Coro<T>& coro, priority_t prio = priority_t{}) noexcept {
+        WaitJob waiter;
+        schedule(coro, tag_t{}, &waiter, 1, prio);
+        if (!JobSystem().wait(waiter)) return T{};  //terminated, the Coro has not set its value
+        return coro.get();
+    }
+
+    /**
+    * \brief Schedule a Coro and wait until it has finished, e.g. from a thread outside of the pool, see vgjs::wait().
+    * \param[in] coro The Coro, it must not have been created by another coro.
+    * \param[in] prio Priority of the Coro if it does not have one.
+    * \returns the promised value.
+    */
+    template<typename T>
+    requires (!std::is_void_v<T>)
+    T wait(Coro<T>&& coro, priority_t prio = priority_t{}) noexcept {
+        return wait(coro, prio);
+    }
+
+
     template<typename T>
     requires CORO<T>
     void continuation(T&& coro) noexcept {
@@ -186,13 +219,18 @@ namespace vgjs {
         }
 
         /**
-        * \brief Schedule tag jobs. Resume immediately if there were no jobs.
+        * \brief Schedule tag jobs. Resume immediately if there were no jobs, or if they have all finished already.
+        *
+        * The jobs are scheduled while the coro holds an extra child, so that they cannot resume it before
+        * the number of jobs is known.
+        *
         * \param[in] h The coro handle, can be used to get the promise.
         * \returns true of the coro should be suspended, else false.
         */
         bool await_suspend(n_exp::coroutine_handle<Coro_promise<PT>> h) noexcept {
+            h.promise().m_children.fetch_add(1);
             m_number = JobSystem().schedule_tag(m_tag);
-            return m_number > 0;     //if jobs were scheduled - await them
+            return h.promise().m_children.fetch_sub(1) != 1;     //if jobs are still running - await them
         }
 
         /**
@@ -259,11 +297,29 @@ namespace vgjs {
         * The coro should suspend if m_tag is -1
         * The coro should continue if m_tag>=0 
         *
+        * A single child coro is not scheduled, if possible the parent transfers to it right away like a function call.
+        *
         * \param[in] h The coro handle, can be used to get the promise.
-        * \returns true if the coro suspends, or false if the coro should continue.
+        * \returns the handle of the single child coro to run right away, a noop handle if the coro suspends, or h if the coro should continue.
         *
         */
-        bool await_suspend(n_exp::coroutine_handle<Coro_promise<PT>> h) noexcept {
+        n_exp::coroutine_handle<> await_suspend(n_exp::coroutine_handle<Coro_promise<PT>> h) noexcept {
+            tag_t tg = m_tag;               //the last child might resume the parent and destroy this awaitable,
+            int32_t number = (int)m_number; //so do not touch members after scheduling
+
+            if constexpr (sizeof...(Ts) == 1 && CORO<std::tuple_element_t<0, std::tuple<Ts...>>>) {
+                auto promise = std::get<0>(m_tuple).promise();
+                if (tg.value < 0 && !promise->is_done()) {
+                    JobSystem js;
+                    promise->m_parent = &h.promise();
+                    js.inherit(promise);
+                    if (js.resume_now(promise)) {           //run the child right away on this thread
+                        h.promise().m_children.fetch_add(1);
+                        return promise->resume_handle();
+                    }
+                }
+            }
+
             auto g = [&, this]<std::size_t Idx>() {
 
                 using tt = decltype(m_tuple);
@@ -286,8 +342,8 @@ namespace vgjs {
                         int i = 3;
                     }*/
 
-                    schedule(std::forward<T>(children), m_tag, &h.promise(), (int)m_number);   //in first call the number of children is the total number of all jobs
-                    m_number = 0;                                               //after this always 0
+                    schedule(std::forward<T>(children), tg, &h.promise(), number);   //in first call the number of children is the total number of all jobs
+                    number = 0;                                                 //after this always 0
                 }
             };
 
@@ -295,9 +351,13 @@ namespace vgjs {
                 ( g.template operator() <Idx> (), ...); //called for every tuple element
             };
 
+            JobSystem js;
+            js.begin_batch();   //all children are pushed at once
             f(std::make_index_sequence<sizeof...(Ts)>{}); //call f and create an integer list going from 0 to sizeof(Ts)-1
+            js.end_batch();
 
-            return m_tag.value < 0; //if tag value < 0 then schedule now, so return true to suspend
+            if (tg.value < 0) return n_exp::noop_coroutine(); //if tag value < 0 then schedule now, so suspend
+            return h;
         }
 
         /**
@@ -382,8 +442,9 @@ namespace vgjs {
         /**
         * \brief After suspension, call parent to run it as continuation
         * \param[in] h Handle of the coro, is used to get the promise (=Job)
+        * \returns the parent coro if it can be resumed right away (symmetric transfer), else a noop handle.
         */
-        void await_suspend(n_exp::coroutine_handle<Coro_promise<U>> h) noexcept { //called after suspending
+        n_exp::coroutine_handle<> await_suspend(n_exp::coroutine_handle<Coro_promise<U>> h) noexcept { //called after suspending
             auto& promise = h.promise();
 
             if (promise.m_parent != nullptr) {          //if there is a parent
@@ -391,13 +452,10 @@ namespace vgjs {
                     JobSystem().child_finished((Job*)promise.m_parent); //indicate that this child has finished
                 }
                 else {  //parent is a coro
-                    uint32_t num = promise.m_parent->m_children.fetch_sub(1);   //one less child
-                    if (num == 1) {                                             //was it the last child?
-                        JobSystem().schedule_job(promise.m_parent);      //if last reschedule the parent coro
-                    }
+                    return resume_parent(promise.m_parent);     //if last child then resume the parent coro
                 }
             }
-            return;
+            return n_exp::noop_coroutine();
         }
     };
 
@@ -417,24 +475,26 @@ namespace vgjs {
         /**
         * \brief After suspension, call parent to run it as continuation
         * \param[in] h Handle of the coro, is used to get the promise (=Job)
+        * \returns the parent coro if it can be resumed right away (symmetric transfer), else a noop handle.
         */
-        bool await_suspend(n_exp::coroutine_handle<Coro_promise<U>> h) noexcept { //called after suspending
+        n_exp::coroutine_handle<> await_suspend(n_exp::coroutine_handle<Coro_promise<U>> h) noexcept { //called after suspending
             auto& promise = h.promise();
             bool is_parent_function = promise.m_is_parent_function;
             auto parent = promise.m_parent;
+            JobSystem().count_deadline(&promise);
 
             if (parent != nullptr) {          //if there is a parent
                 if (is_parent_function) {       //if it is a Job
                     JobSystem().child_finished((Job*)parent);//indicate that this child has finished
                 }
                 else {
-                    uint32_t num = parent->m_children.fetch_sub(1);        //one less child
-                    if (num == 1) {                                             //was it the last child?
-                        JobSystem().schedule_job(parent);      //if last reschedule the parent coro
-                    }
+                    return resume_parent(parent);   //if parent is coro, then you are in sync -> the future will destroy the promise
                 }
             }
-            return !is_parent_function; //if parent is coro, then you are in sync -> the future will destroy the promise
+            if (is_parent_function) {
+                h.destroy();                    //parent is a Function or nullptr, so the promise destroys itself
+            }
+            return n_exp::noop_coroutine();     //else the future owns the promise and destroys it
         }
     };
 
@@ -490,6 +550,19 @@ namespace vgjs {
             return true;
         };
 
+        /**
+        * \brief Get the handle for resuming the Coro right away, e.g. by symmetric transfer.
+        * \returns the handle of the coroutine.
+        */
+        n_exp::coroutine_handle<> resume_handle() noexcept {
+            if (m_is_parent_function && m_ready_ptr != nullptr) {
+                *m_ready_ptr = false;   //invalidate return value
+            }
+            return m_coro;
+        }
+
+        bool is_done() noexcept { return !m_coro || m_coro.done(); }
+
         void set_self_destruct(bool b = true) { m_self_destruct = b; }
         bool get_self_destruct() { return m_self_destruct; }
 
@@ -541,7 +614,7 @@ namespace vgjs {
         /**
         * \returns a deallocator, used only if program ends.
         */
-        job_deallocator get_deallocator() noexcept { return coro_deallocator<T>{}; };    //called for deallocation
+        job_deallocator& get_deallocator() noexcept { static coro_deallocator<T> da; return da; };    //called for deallocation
 
         /**
         * \brief Store the value returned by co_return.
@@ -606,6 +679,26 @@ namespace vgjs {
     };
 
 
+    /**
+    * \brief A child of a parent coro has finished or yielded. If it was the last child, then the parent goes on.
+    *
+    * If possible, the parent is resumed right away on this thread by symmetric transfer, which does
+    * not grow the stack. Else the parent is scheduled.
+    *
+    * \param[in] parent The promise of the parent coro.
+    * \returns the handle of the parent if it should be resumed right away, else a noop handle.
+    */
+    inline n_exp::coroutine_handle<> resume_parent(Job_base* parent) noexcept {
+        uint32_t num = parent->m_children.fetch_sub(1);     //one less child
+        if (num != 1) return n_exp::noop_coroutine();       //the parent still waits for other children
+        if (JobSystem().resume_now(parent)) {
+            return static_cast<Coro_promise_base*>(parent)->resume_handle();
+        }
+        JobSystem().schedule_next(parent);                  //reschedule the parent coro
+        return n_exp::noop_coroutine();
+    }
+
+
     //---------------------------------------------------------------------------------------------------
     //the coro future classes
 
@@ -737,12 +830,17 @@ namespace vgjs {
         * \param[in] thread_index The thread that should execute this coro
         * \param[in] type The type of the coro.
         * \param[in] id A unique ID of the call.
+        * \param[in] prio The priority of the coro, if empty it inherits the priority of its parent.
+        * \param[in] deadline The coro should be finished by then, if empty it inherits the deadline of its parent.
         * \returns a reference to this Coro so that it can be used with co_await.
         */
-        decltype(auto) operator() (thread_index_t index = thread_index_t{}, thread_type_t type = thread_type_t{}, thread_id_t id = thread_id_t{}) {
+        decltype(auto) operator() (thread_index_t index = thread_index_t{}, thread_type_t type = thread_type_t{}, thread_id_t id = thread_id_t{}
+                                    , priority_t prio = priority_t{}, deadline_t deadline = no_deadline) {
             m_promise->m_thread_index = index;
             m_promise->m_type = type;
             m_promise->m_id = id;
+            m_promise->m_priority = prio;
+            m_promise->m_deadline = deadline;
             return std::move(*this);
         }
     };
@@ -755,7 +853,7 @@ namespace vgjs {
     */
     template<>
     struct yield_awaiter<void> : public suspend_always {
-        void await_suspend(n_exp::coroutine_handle<Coro_promise<void>> h) noexcept;
+        n_exp::coroutine_handle<> await_suspend(n_exp::coroutine_handle<Coro_promise<void>> h) noexcept;
     };
 
     /**
@@ -763,7 +861,7 @@ namespace vgjs {
     */
     template<>
     struct final_awaiter<void> : public n_exp::suspend_always {
-        bool await_suspend(n_exp::coroutine_handle<Coro_promise<void>> h) noexcept;
+        n_exp::coroutine_handle<> await_suspend(n_exp::coroutine_handle<Coro_promise<void>> h) noexcept;
     };
 
     /**
@@ -789,7 +887,7 @@ namespace vgjs {
         /**
         * \returns a deallocator, used only if program ends.
         */
-        job_deallocator get_deallocator() noexcept { return coro_deallocator<void>{}; };    //called for deallocation
+        job_deallocator& get_deallocator() noexcept { static coro_deallocator<void> da; return da; };    //called for deallocation
 
         /**
         * \brief Return from aco_return.
@@ -900,12 +998,17 @@ namespace vgjs {
         * \param[in] thread_index The thread that should execute this coro
         * \param[in] type The type of the coro.
         * \param[in] id A unique ID of the call.
+        * \param[in] prio The priority of the coro, if empty it inherits the priority of its parent.
+        * \param[in] deadline The coro should be finished by then, if empty it inherits the deadline of its parent.
         * \returns a reference to this Coro so that it can be used with co_await.
         */
-        decltype(auto) operator() (thread_index_t index = thread_index_t{}, thread_type_t type = thread_type_t{}, thread_id_t id = thread_id_t{}) {
+        decltype(auto) operator() (thread_index_t index = thread_index_t{}, thread_type_t type = thread_type_t{}, thread_id_t id = thread_id_t{}
+                                    , priority_t prio = priority_t{}, deadline_t deadline = no_deadline) {
             m_promise->m_thread_index = index;
             m_promise->m_type = type;
             m_promise->m_id = id;
+            m_promise->m_priority = prio;
+            m_promise->m_deadline = deadline;
             return std::move(*this);
         }
     };
@@ -952,8 +1055,9 @@ namespace vgjs {
     /**
     * \brief After suspension, call parent to run it as continuation
     * \param[in] h Handle of the coro, is used to get the promise (=Job)
+    * \returns the parent coro if it can be resumed right away (symmetric transfer), else a noop handle.
     */
-    inline void yield_awaiter<void>::await_suspend(n_exp::coroutine_handle<Coro_promise<void>> h) noexcept { //called after suspending
+    inline n_exp::coroutine_handle<> yield_awaiter<void>::await_suspend(n_exp::coroutine_handle<Coro_promise<void>> h) noexcept { //called after suspending
         Coro_promise<void>& promise = h.promise();                 ///<tmp pointer to promise
         bool is_parent_function = promise.m_is_parent_function;    ///<tmp copy of flag
         auto parent = promise.m_parent;                            ///<tmp pointer to parent
@@ -963,37 +1067,36 @@ namespace vgjs {
                 JobSystem().child_finished((Job*)parent); //indicate that this child has suspended
             }
             else {  //parent is a coro
-                uint32_t num = parent->m_children.fetch_sub(1);   //one less child
-                if (num == 1) {                                   //was it the last child?
-                    JobSystem().schedule_job(parent);       //if last reschedule the parent coro
-                }
+                return resume_parent(parent);       //if last child then resume the parent coro
             }
         }
-        return;
+        return n_exp::noop_coroutine();
     }
 
 
     /**
     * \brief After suspension, call parent to run it as continuation
     * \param[in] h Handle of the coro, is used to get the promise (=Job)
+    * \returns the parent coro if it can be resumed right away (symmetric transfer), else a noop handle.
     */
-    inline bool final_awaiter<void>::await_suspend(n_exp::coroutine_handle<Coro_promise<void>> h) noexcept { //called after suspending
+    inline n_exp::coroutine_handle<> final_awaiter<void>::await_suspend(n_exp::coroutine_handle<Coro_promise<void>> h) noexcept { //called after suspending
         Coro_promise<void>& promise = h.promise();                 ///<tmp pointer to promise
         bool is_parent_function = promise.m_is_parent_function;    ///<tmp copy of flag
         auto parent = promise.m_parent;                            ///<tmp pointer to parent
+        JobSystem().count_deadline(&promise);
 
         if (parent != nullptr) {            //if there is a parent
             if (is_parent_function) {       //if it is a Job
                 JobSystem().child_finished((Job*)promise.m_parent);//indicate that this child has finished
             }
             else {
-                uint32_t num = parent->m_children.fetch_sub(1);   //one less child
-                if (num == 1) {                                   //was it the last child?
-                    JobSystem().schedule_job(parent);       //if last reschedule the parent coro
-                }
+                return resume_parent(parent);   //if parent is coro, then you are in sync -> the future will destroy the promise
             }
         }
-        return !is_parent_function; //if parent is coro, then you are in sync -> the future will destroy the promise
+        if (is_parent_function) {
+            h.destroy();                    //parent is a Function or nullptr, so the promise destroys itself
+        }
+        return n_exp::noop_coroutine();     //else the future owns the promise and destroys it
     }
 
 
@@ -1005,7 +1108,8 @@ namespace vgjs {
     * \brief Use the given memory resource to create the promise object for a normal function.
     *
     * Store the pointer to the memory resource right after the promise, so it can be used later
-    * for deallocating the promise.
+    * for deallocating the promise. The memory is aligned to and padded to whole cache lines, so
+    * coros running on different threads do not falsely share a cache line.
     *
     * \param[in] sz Number of bytes to allocate.
     * \param[in] std::allocator_arg_t Dummy parameter to indicate that the next parameter is the memory resource to use.
@@ -1017,7 +1121,8 @@ namespace vgjs {
     inline void* Coro_promise_base::operator new(std::size_t sz, std::allocator_arg_t, n_pmr::memory_resource* mr, Args&&... args) noexcept {
         //std::cout << "Coro new " << sz << "\n";
         auto allocatorOffset = (sz + alignof(n_pmr::memory_resource*) - 1) & ~(alignof(n_pmr::memory_resource*) - 1);
-        char* ptr = (char*)mr->allocate(allocatorOffset + sizeof(mr));
+        auto bytes = (allocatorOffset + sizeof(mr) + cache_line_size - 1) & ~(cache_line_size - 1);
+        char* ptr = (char*)mr->allocate(bytes, cache_line_size);
         if (ptr == nullptr) {
             std::terminate();
         }
@@ -1078,8 +1183,9 @@ namespace vgjs {
     inline void Coro_promise_base::operator delete(void* ptr, std::size_t sz) noexcept {
         //std::cout << "Coro delete " << sz << "\n";
         auto allocatorOffset = (sz + alignof(n_pmr::memory_resource*) - 1) & ~(alignof(n_pmr::memory_resource*) - 1);
+        auto bytes = (allocatorOffset + sizeof(n_pmr::memory_resource*) + cache_line_size - 1) & ~(cache_line_size - 1);
         auto allocator = (n_pmr::memory_resource**)((char*)(ptr)+allocatorOffset);
-        (*allocator)->deallocate(ptr, allocatorOffset + sizeof(n_pmr::memory_resource*));
+        (*allocator)->deallocate(ptr, bytes, cache_line_size);
     }
 
     //---------------------------------------------------------------------------------------------------